@@ -30,13 +30,14 @@ extern "C"{
 #include "lwip/err.h"
 }
 #include "esp_task_wdt.h"
+#include <new>
 
 /*
  * TCP/IP Event Task
  * */
 
 typedef enum {
-    LWIP_TCP_SENT, LWIP_TCP_RECV, LWIP_TCP_FIN, LWIP_TCP_ERROR, LWIP_TCP_POLL, LWIP_TCP_CLEAR, LWIP_TCP_ACCEPT, LWIP_TCP_CONNECTED, LWIP_TCP_DNS
+    LWIP_TCP_SENT, LWIP_TCP_RECV, LWIP_TCP_FIN, LWIP_TCP_ERROR, LWIP_TCP_POLL, LWIP_TCP_CLEAR, LWIP_TCP_ACCEPT, LWIP_TCP_CONNECTED, LWIP_TCP_DNS, LWIP_TCP_CALL
 } lwip_event_t;
 
 typedef struct {
@@ -73,6 +74,10 @@ typedef struct {
                         const char * name;
                         ip_addr_t addr;
                 } dns;
+                struct {
+                        void (*fn)(void *);
+                        void * arg;
+                } call;
         };
 } lwip_event_packet_t;
 
@@ -93,6 +98,103 @@ static uint32_t _closed_index = []() {
 }();
 
 
+/*
+ * Client Pool
+ * */
+
+typedef struct async_client_pool {
+    uint8_t * slots;
+    size_t capacity;
+    void ** free_slots;
+    size_t free_count;
+    struct async_client_pool * next;
+} async_client_pool_t;
+
+static async_client_pool_t * _client_pools = NULL;
+//created once at startup, before any server can make a pool. A mutex, so a lower priority holder is raised to the tcpip thread's priority
+static SemaphoreHandle_t _client_pools_lock = xSemaphoreCreateMutex();
+//the tcpip thread gives up on a pooled client after this, the lock is only ever held for a few pointer updates
+#define CLIENT_POOL_LWIP_WAIT pdMS_TO_TICKS(10)
+
+static async_client_pool_t * _client_pool_create(size_t capacity){
+    if(!_client_pools_lock){
+        return NULL;
+    }
+    async_client_pool_t * pool = (async_client_pool_t *)malloc(sizeof(async_client_pool_t));
+    if(!pool){
+        return NULL;
+    }
+    pool->slots = (uint8_t *)malloc(capacity * sizeof(AsyncClient));
+    pool->free_slots = (void **)malloc(capacity * sizeof(void *));
+    if(!pool->slots || !pool->free_slots){
+        free(pool->slots);
+        free(pool->free_slots);
+        free(pool);
+        return NULL;
+    }
+    pool->capacity = capacity;
+    for(size_t i = 0; i < capacity; i++){
+        pool->free_slots[i] = pool->slots + (i * sizeof(AsyncClient));
+    }
+    pool->free_count = capacity;
+    xSemaphoreTake(_client_pools_lock, portMAX_DELAY);
+    pool->next = _client_pools;
+    _client_pools = pool;
+    xSemaphoreGive(_client_pools_lock);
+    return pool;
+}
+
+//pools with clients still in use are kept alive, their clients return to them on delete
+static bool _client_pool_destroy(async_client_pool_t * pool){
+    xSemaphoreTake(_client_pools_lock, portMAX_DELAY);
+    if(pool->free_count != pool->capacity){
+        xSemaphoreGive(_client_pools_lock);
+        return false;
+    }
+    async_client_pool_t ** p = &_client_pools;
+    while(*p && *p != pool){
+        p = &(*p)->next;
+    }
+    if(*p){
+        *p = pool->next;
+    }
+    xSemaphoreGive(_client_pools_lock);
+    free(pool->slots);
+    free(pool->free_slots);
+    free(pool);
+    return true;
+}
+
+//In LwIP Thread
+static void * _client_pool_take(async_client_pool_t * pool){
+    void * slot = NULL;
+    if(xSemaphoreTake(_client_pools_lock, CLIENT_POOL_LWIP_WAIT) != pdTRUE){
+        return NULL;
+    }
+    if(pool->free_count){
+        slot = pool->free_slots[--pool->free_count];
+    }
+    xSemaphoreGive(_client_pools_lock);
+    return slot;
+}
+
+static bool _client_pool_give(void * slot){
+    if(!_client_pools){
+        return false;
+    }
+    bool found = false;
+    xSemaphoreTake(_client_pools_lock, portMAX_DELAY);
+    for(async_client_pool_t * pool = _client_pools; pool; pool = pool->next){
+        if((uint8_t *)slot >= pool->slots && (uint8_t *)slot < pool->slots + (pool->capacity * sizeof(AsyncClient))){
+            pool->free_slots[pool->free_count++] = slot;
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(_client_pools_lock);
+    return found;
+}
+
 static inline bool _init_async_event_queue(){
     if(!_async_queue){
         _async_queue = xQueueCreate(32, sizeof(lwip_event_packet_t *));
@@ -152,7 +254,9 @@ static bool _remove_events_with_arg(void * arg){
 }
 
 static void _handle_async_event(lwip_event_packet_t * e){
-    if(e->arg == NULL){
+    if(e->event == LWIP_TCP_CALL){
+        e->call.fn(e->call.arg);
+    } else if(e->arg == NULL){
         // do nothing when arg is NULL
         //ets_printf("event arg == NULL: 0x%08x\n", e->recv.pcb);
     } else if(e->event == LWIP_TCP_CLEAR){
@@ -585,6 +689,12 @@ AsyncClient::~AsyncClient(){
     _free_closed_slot();
 }
 
+void AsyncClient::operator delete(void * ptr){
+    if(!_client_pool_give(ptr)){
+        ::operator delete(ptr);
+    }
+}
+
 /*
  * Operators
  * */
@@ -871,6 +981,8 @@ void AsyncClient::_error(int8_t err) {
         }
         _pcb = NULL;
     }
+    //lwIP has freed the pcb, drop what it queued for us before we are discarded
+    _tcp_clear_events(this);
     if(_error_cb) {
         _error_cb(_error_cb_arg, this, err);
     }
@@ -994,6 +1106,23 @@ void AsyncClient::_dns_found(struct ip_addr *ipaddr){
  * Public Helper Methods
  * */
 
+bool AsyncClient::call(void (*fn)(void *), void * arg){
+    // arg stays NULL, so no client's _tcp_clear_events() drops the call
+    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    if(!e){
+        return false;
+    }
+    e->event = LWIP_TCP_CALL;
+    e->arg = NULL;
+    e->call.fn = fn;
+    e->call.arg = arg;
+    if (!_async_queue || xQueueSend(_async_queue, &e, 0) != pdPASS) {
+        free((void*)(e));
+        return false;
+    }
+    return true;
+}
+
 void AsyncClient::stop() {
     close(false);
 }
@@ -1241,6 +1370,7 @@ AsyncServer::AsyncServer(IPAddress addr, uint16_t port)
 , _pcb(0)
 , _connect_cb(0)
 , _connect_cb_arg(0)
+, _clientPool(NULL)
 {}
 
 AsyncServer::AsyncServer(uint16_t port)
@@ -1250,10 +1380,14 @@ AsyncServer::AsyncServer(uint16_t port)
 , _pcb(0)
 , _connect_cb(0)
 , _connect_cb_arg(0)
+, _clientPool(NULL)
 {}
 
 AsyncServer::~AsyncServer(){
     end();
+    if(_clientPool && !_client_pool_destroy(_clientPool)){
+        log_w("client pool still in use");
+    }
 }
 
 void AsyncServer::onClient(AcConnectHandler cb, void* arg){
@@ -1261,11 +1395,19 @@ void AsyncServer::onClient(AcConnectHandler cb, void* arg){
     _connect_cb_arg = arg;
 }
 
-void AsyncServer::begin(){
+void AsyncServer::begin(size_t maxClients){
     if(_pcb) {
         return;
     }
 
+    if(maxClients && !_clientPool){
+        _clientPool = _client_pool_create(maxClients);
+        if(!_clientPool){
+            log_e("failed to allocate client pool");
+            return;
+        }
+    }
+
     if(!_start_async_task()){
         log_e("failed to start task");
         return;
@@ -1313,7 +1455,17 @@ void AsyncServer::end(){
 int8_t AsyncServer::_accept(tcp_pcb* pcb, int8_t err){
     //ets_printf("+A: 0x%08x\n", pcb);
     if(_connect_cb){
-        AsyncClient *c = new AsyncClient(pcb);
+        AsyncClient *c = NULL;
+        if(_clientPool){
+            void * slot = _client_pool_take(_clientPool);
+            if(slot){
+                c = new (slot) AsyncClient(pcb);
+            } else {
+                log_w("no pooled client available");
+            }
+        } else {
+            c = new AsyncClient(pcb);
+        }
         if(c){
             c->setNoDelay(_noDelay);
             return _tcp_accept(this, c);
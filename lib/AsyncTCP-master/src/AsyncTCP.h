@@ -51,12 +51,15 @@ typedef std::function<void(void*, AsyncClient*, uint32_t time)> AcTimeoutHandler
 
 struct tcp_pcb;
 struct ip_addr;
+struct async_client_pool;
 
 class AsyncClient {
   public:
     AsyncClient(tcp_pcb* pcb = 0);
     ~AsyncClient();
 
+    static void operator delete(void * ptr);//returns pooled clients to their server pool
+
     AsyncClient & operator=(const AsyncClient &other);
     AsyncClient & operator+=(const AsyncClient &other);
 
@@ -118,6 +121,7 @@ class AsyncClient {
     void onPacket(AcPacketHandler cb, void* arg = 0);       //data received
     void onTimeout(AcTimeoutHandler cb, void* arg = 0);     //ack timeout
     void onPoll(AcConnectHandler cb, void* arg = 0);        //every 125ms when connected
+    static bool call(void (*fn)(void *), void * arg);//runs fn(arg) on the async task, e.g. once another task made data ready to send. Safe from any task, never waits: false when the queue is full
 
     void ackPacket(struct pbuf * pb);//ack pbuf from onPacket
     size_t ack(size_t len); //ack data that you have not acked using the method below
@@ -191,7 +195,7 @@ class AsyncServer {
     AsyncServer(uint16_t port);
     ~AsyncServer();
     void onClient(AcConnectHandler cb, void* arg);
-    void begin();
+    void begin(size_t maxClients = 0);//maxClients > 0 preallocates a fixed pool of clients, connections above it are refused
     void end();
     void setNoDelay(bool nodelay);
     bool getNoDelay();
@@ -208,6 +212,7 @@ class AsyncServer {
     tcp_pcb* _pcb;
     AcConnectHandler _connect_cb;
     void* _connect_cb_arg;
+    async_client_pool* _clientPool;
 
     int8_t _accept(tcp_pcb* newpcb, int8_t err);
     int8_t _accepted(AsyncClient* client);
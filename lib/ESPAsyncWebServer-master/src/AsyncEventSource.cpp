@@ -354,8 +354,7 @@ AsyncEventSourceResponse::AsyncEventSourceResponse(AsyncEventSource *server){
 }
 
 void AsyncEventSourceResponse::_respond(AsyncWebServerRequest *request){
-  String out = _assembleHead(request->version());
-  request->client()->write(out.c_str(), _headLength);
+  _sendHead(request);
   _state = RESPONSE_WAIT_ACK;
 }
 
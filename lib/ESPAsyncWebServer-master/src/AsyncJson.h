@@ -240,12 +240,25 @@ public:
   }
   virtual void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override final {
     if (_onRequest) {
-      _contentLength = total;
-      if (total > 0 && request->_tempObject == NULL && total < _maxContentLength) {
-        request->_tempObject = malloc(total);
+      // chunked bodies come with a total of 0, their buffer grows as they arrive
+      size_t length = total ? total : index + len;
+      _contentLength = length;
+      if (length >= _maxContentLength) {
+        free(request->_tempObject);
+        request->_tempObject = NULL;
+        return;
+      }
+      if ((request->_tempObject == NULL && index == 0) || (request->_tempObject != NULL && total == 0)) {
+        // one byte more keeps the buffer NUL terminated for the parser
+        void* buffer = realloc(request->_tempObject, length + 1);
+        if (buffer == NULL) {
+          free(request->_tempObject);
+        }
+        request->_tempObject = buffer;
       }
       if (request->_tempObject != NULL) {
         memcpy((uint8_t*)(request->_tempObject) + index, data, len);
+        ((uint8_t*)(request->_tempObject))[index + len] = 0;
       }
     }
   }
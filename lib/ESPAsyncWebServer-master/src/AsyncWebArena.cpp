@@ -0,0 +1,88 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "AsyncWebArena.h"
+#include <stdlib.h>
+#include <string.h>
+
+AsyncWebArena::AsyncWebArena(void* slab, size_t slabSize, size_t chunkSize)
+  : _slab((uint8_t*)slab)
+  , _slabSize(slab ? slabSize : 0)
+  , _chunkSize(chunkSize)
+  , _chunks(nullptr)
+  , _cur(_slab)
+  , _end(_slab + _slabSize)
+  , _used(0)
+{}
+
+void* AsyncWebArena::alloc(size_t size, size_t align){
+  if(!size)
+    size = 1;
+  uintptr_t p = ((uintptr_t)_cur + align - 1) & ~(uintptr_t)(align - 1);
+  if(!_cur || p + size > (uintptr_t)_end){
+    // Start a new chunk, oversized requests get a chunk of their own
+    size_t header = (sizeof(Chunk) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+    size_t need = header + size + align;
+    size_t chunkSize = (need > _chunkSize) ? need : _chunkSize;
+    Chunk* chunk = (Chunk*)malloc(chunkSize);
+    if(chunk == NULL)
+      return nullptr;
+    chunk->next = _chunks;
+    chunk->size = chunkSize;
+    _chunks = chunk;
+    _cur = (uint8_t*)chunk + header;
+    _end = (uint8_t*)chunk + chunkSize;
+    p = ((uintptr_t)_cur + align - 1) & ~(uintptr_t)(align - 1);
+  }
+  _cur = (uint8_t*)(p + size);
+  _used += size;
+  return (void*)p;
+}
+
+char* AsyncWebArena::strdup(const char* str, size_t len){
+  char* out = (char*)alloc(len + 1, 1);
+  if(out){
+    memcpy(out, str, len);
+    out[len] = 0;
+  }
+  return out;
+}
+
+bool AsyncWebArena::owns(const void* ptr) const {
+  const uint8_t* p = (const uint8_t*)ptr;
+  if(_slab && p >= _slab && p < _slab + _slabSize)
+    return true;
+  for(Chunk* c = _chunks; c; c = c->next){
+    if(p >= (const uint8_t*)c && p < (const uint8_t*)c + c->size)
+      return true;
+  }
+  return false;
+}
+
+void AsyncWebArena::release(){
+  while(_chunks != nullptr){
+    Chunk* c = _chunks;
+    _chunks = c->next;
+    free(c);
+  }
+  _cur = _slab;
+  _end = _slab + _slabSize;
+  _used = 0;
+}
@@ -0,0 +1,82 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASYNCWEBARENA_H_
+#define ASYNCWEBARENA_H_
+
+#include "stddef.h"
+#include <stdint.h>
+#include <new>
+#include <utility>
+
+// Size of the heap chunks the arena grows by once the first slab is used up
+#ifndef ASYNCWEBSERVER_ARENA_CHUNK_SIZE
+#define ASYNCWEBSERVER_ARENA_CHUNK_SIZE 512
+#endif
+
+/*
+ * ARENA :: Bump-pointer allocator for objects that live exactly as long as their owner
+ *
+ * Memory is handed out from an optional caller supplied slab first and from
+ * malloc'ed chunks after that. Nothing is freed individually, everything is
+ * returned in one go by release() (or the destructor). Objects with non-trivial
+ * destructors must be destroyed with destroy() before the arena goes away.
+ * */
+
+class AsyncWebArena {
+  private:
+    struct Chunk {
+      Chunk* next;
+      size_t size;
+    };
+    uint8_t* _slab;
+    size_t _slabSize;
+    size_t _chunkSize;
+    Chunk* _chunks;
+    uint8_t* _cur;
+    uint8_t* _end;
+    size_t _used;
+
+  public:
+    AsyncWebArena(void* slab=nullptr, size_t slabSize=0, size_t chunkSize=ASYNCWEBSERVER_ARENA_CHUNK_SIZE);
+    ~AsyncWebArena(){ release(); }
+
+    AsyncWebArena(AsyncWebArena const &) = delete;
+    AsyncWebArena &operator=(AsyncWebArena const &) = delete;
+
+    void* alloc(size_t size, size_t align=alignof(max_align_t));
+    char* strdup(const char* str, size_t len);
+    bool owns(const void* ptr) const;
+    void release();
+    size_t used() const { return _used; }
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args){
+      void* p = alloc(sizeof(T), alignof(T));
+      return p ? new (p) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    template<typename T>
+    static void destroy(T* obj){
+      if(obj) obj->~T();
+    }
+};
+
+#endif /* ASYNCWEBARENA_H_ */
@@ -0,0 +1,313 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "AsyncWebDeflate.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WINDOW ASYNCWEBSERVER_DEFLATE_WINDOW
+#define HASH_BITS 10
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MAX_CHAIN 16
+
+enum { DEFLATE_HEADER, DEFLATE_BODY, DEFLATE_FINISH, DEFLATE_TRAILER, DEFLATE_DONE };
+
+static_assert((WINDOW & (WINDOW - 1)) == 0 && WINDOW >= 512 && WINDOW <= 16384, "ASYNCWEBSERVER_DEFLATE_WINDOW");
+static_assert(ASYNCWEBSERVER_DEFLATE_OUTPUT >= 64, "ASYNCWEBSERVER_DEFLATE_OUTPUT");
+
+// RFC 1951, 3.2.5
+static const uint16_t LENGTH_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DISTANCE_BASE[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// CRC-32 as gzip uses it, a nibble at a time
+static const uint32_t CRC_TABLE[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len){
+  crc = ~crc;
+  while(len--){
+    crc ^= *data++;
+    crc = (crc >> 4) ^ CRC_TABLE[crc & 15];
+    crc = (crc >> 4) ^ CRC_TABLE[crc & 15];
+  }
+  return ~crc;
+}
+
+AsyncWebDeflate::AsyncWebDeflate()
+  : _window(NULL)
+  , _head(NULL)
+  , _prev(NULL)
+  , _pos(0)
+  , _end(0)
+  , _bits(0)
+  , _bitCount(0)
+  , _state(DEFLATE_HEADER)
+  , _crc(0)
+  , _size(0)
+  , _outStart(0)
+  , _outEnd(0)
+{}
+
+AsyncWebDeflate::~AsyncWebDeflate(){
+  free(_window);
+  free(_head);
+  free(_prev);
+}
+
+bool AsyncWebDeflate::begin(){
+  _window = (uint8_t*)malloc(2 * WINDOW);
+  _head = (uint16_t*)calloc(1 << HASH_BITS, sizeof(uint16_t));
+  _prev = (uint16_t*)calloc(WINDOW, sizeof(uint16_t));
+  if(!_window || !_head || !_prev)
+    return false;
+
+  // gzip member header (RFC 1952) without name or time, then one fixed Huffman block for all of the data
+  static const uint8_t header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+  memcpy(_out, header, sizeof(header));
+  _outEnd = sizeof(header);
+  _putBits(0, 1); // BFINAL, the closing block comes in finish
+  _putBits(1, 2); // BTYPE fixed
+  _state = DEFLATE_BODY;
+  return true;
+}
+
+void AsyncWebDeflate::_putBits(uint32_t value, uint8_t count){
+  _bits |= value << _bitCount;
+  _bitCount += count;
+  while(_bitCount >= 8){
+    _out[_outEnd++] = _bits & 0xff;
+    _bits >>= 8;
+    _bitCount -= 8;
+  }
+}
+
+void AsyncWebDeflate::_putCode(uint32_t code, uint8_t count){
+  uint32_t reversed = 0;
+  for(uint8_t i = 0; i < count; i++){
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  _putBits(reversed, count);
+}
+
+void AsyncWebDeflate::_literal(uint8_t c){
+  if(c < 144)
+    _putCode(0x30 + c, 8);
+  else
+    _putCode(0x190 + c - 144, 9);
+}
+
+void AsyncWebDeflate::_match(size_t length, size_t distance){
+  uint8_t i = 28;
+  while(LENGTH_BASE[i] > length)
+    i--;
+  uint16_t symbol = 257 + i;
+  if(symbol < 280)
+    _putCode(symbol - 256, 7);
+  else
+    _putCode(0xc0 + symbol - 280, 8);
+  _putBits(length - LENGTH_BASE[i], LENGTH_EXTRA[i]);
+
+  uint8_t d = 29;
+  while(DISTANCE_BASE[d] > distance)
+    d--;
+  _putCode(d, 5);
+  _putBits(distance - DISTANCE_BASE[d], DISTANCE_EXTRA[d]);
+}
+
+static inline uint32_t hash3(const uint8_t* p){
+  uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+  return (uint32_t)(v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void AsyncWebDeflate::_insert(size_t pos){
+  if(pos + MIN_MATCH > _end)
+    return;
+  uint32_t h = hash3(_window + pos);
+  _prev[pos & (WINDOW - 1)] = _head[h];
+  _head[h] = pos + 1;
+}
+
+size_t AsyncWebDeflate::_longestMatch(size_t* distance){
+  size_t available = _end - _pos;
+  if(available > MAX_MATCH)
+    available = MAX_MATCH;
+  if(available < MIN_MATCH)
+    return 0;
+  size_t limit = _pos > WINDOW ? _pos - WINDOW : 0;
+  const uint8_t* current = _window + _pos;
+  size_t best = 0;
+  size_t candidate = _head[hash3(current)];
+  for(uint8_t tries = 0; candidate && tries < MAX_CHAIN; tries++){
+    size_t at = candidate - 1;
+    if(at < limit || at >= _pos)
+      break;
+    const uint8_t* p = _window + at;
+    if(p[best] == current[best]){
+      size_t length = 0;
+      while(length < available && p[length] == current[length])
+        length++;
+      if(length > best){
+        best = length;
+        *distance = _pos - at;
+        if(best == available)
+          break;
+      }
+    }
+    size_t next = _prev[at & (WINDOW - 1)];
+    if(next >= candidate)
+      break; // overwritten by a newer position, the rest of the chain is gone
+    candidate = next;
+  }
+  return best >= MIN_MATCH ? best : 0;
+}
+
+// Compresses while a full match length of input is ahead, or everything once finishing
+void AsyncWebDeflate::_compress(){
+  if(_outStart){
+    memmove(_out, _out + _outStart, _outEnd - _outStart);
+    _outEnd -= _outStart;
+    _outStart = 0;
+  }
+  while(_outEnd + 8 <= sizeof(_out) && (_end - _pos >= MAX_MATCH || (_state == DEFLATE_FINISH && _pos < _end))){
+    size_t distance = 0;
+    size_t length = _longestMatch(&distance);
+    if(length){
+      _match(length, distance);
+      for(size_t i = 0; i < length; i++)
+        _insert(_pos + i);
+      _pos += length;
+    } else {
+      _literal(_window[_pos]);
+      _insert(_pos);
+      _pos++;
+    }
+  }
+  if(_state == DEFLATE_FINISH && _pos == _end && _outEnd + 16 <= sizeof(_out)){
+    _putCode(0, 7);  // end of the data block
+    _putBits(1, 1);  // and an empty final one
+    _putBits(1, 2);
+    _putCode(0, 7);
+    if(_bitCount)
+      _putBits(0, 8 - _bitCount);
+    for(uint8_t i = 0; i < 4; i++)
+      _out[_outEnd++] = (_crc >> (8 * i)) & 0xff;
+    for(uint8_t i = 0; i < 4; i++)
+      _out[_outEnd++] = (_size >> (8 * i)) & 0xff;
+    _state = DEFLATE_TRAILER;
+  }
+}
+
+uint8_t* AsyncWebDeflate::input(size_t* space){
+  if(_state != DEFLATE_BODY){
+    *space = 0;
+    return NULL;
+  }
+  if(_end == 2 * WINDOW && _pos >= WINDOW){
+    // slide by one window, positions that fall off it are forgotten
+    memmove(_window, _window + WINDOW, WINDOW);
+    _pos -= WINDOW;
+    _end -= WINDOW;
+    for(size_t i = 0; i < (1 << HASH_BITS); i++)
+      _head[i] = _head[i] > WINDOW ? _head[i] - WINDOW : 0;
+    for(size_t i = 0; i < WINDOW; i++)
+      _prev[i] = _prev[i] > WINDOW ? _prev[i] - WINDOW : 0;
+  }
+  *space = 2 * WINDOW - _end;
+  return _window + _end;
+}
+
+void AsyncWebDeflate::commit(size_t len){
+  _crc = crc32(_crc, _window + _end, len);
+  _size += len;
+  _end += len;
+}
+
+void AsyncWebDeflate::finish(){
+  if(_state == DEFLATE_BODY)
+    _state = DEFLATE_FINISH;
+}
+
+size_t AsyncWebDeflate::read(uint8_t* out, size_t len){
+  size_t n = 0;
+  while(n < len){
+    if(_outStart == _outEnd){
+      if(_state == DEFLATE_TRAILER || _state == DEFLATE_DONE){
+        _state = DEFLATE_DONE;
+        break;
+      }
+      size_t before = _outEnd - _outStart + _pos;
+      _compress();
+      if(_outEnd - _outStart + _pos == before && _state != DEFLATE_TRAILER)
+        break; // needs more input
+    }
+    size_t m = _outEnd - _outStart;
+    if(m > len - n)
+      m = len - n;
+    memcpy(out + n, _out + _outStart, m);
+    _outStart += m;
+    n += m;
+  }
+  return n;
+}
+
+bool AsyncWebDeflate::done() const {
+  return _state == DEFLATE_DONE || (_state == DEFLATE_TRAILER && _outStart == _outEnd);
+}
+
+size_t AsyncWebDeflate::gzip(const uint8_t* in, size_t len, uint8_t* out, size_t outLen){
+  AsyncWebDeflate deflate;
+  if(!deflate.begin())
+    return 0;
+  size_t n = 0;
+  while(!deflate.done()){
+    size_t space;
+    uint8_t* to = deflate.input(&space);
+    if(space && len){
+      if(space > len)
+        space = len;
+      memcpy(to, in, space);
+      deflate.commit(space);
+      in += space;
+      len -= space;
+    } else if(!len){
+      deflate.finish();
+    }
+    if(n == outLen && !deflate.done())
+      return 0;
+    n += deflate.read(out + n, outLen - n);
+  }
+  return n;
+}
@@ -0,0 +1,89 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASYNCWEBDEFLATE_H_
+#define ASYNCWEBDEFLATE_H_
+
+#include "stddef.h"
+#include <stdint.h>
+
+// History a match may reach back into, a power of two from 512 to 16384. Memory is about 6 times this
+#ifndef ASYNCWEBSERVER_DEFLATE_WINDOW
+#define ASYNCWEBSERVER_DEFLATE_WINDOW 1024
+#endif
+
+// Compressed bytes held until read, at least 64
+#ifndef ASYNCWEBSERVER_DEFLATE_OUTPUT
+#define ASYNCWEBSERVER_DEFLATE_OUTPUT 256
+#endif
+
+/*
+ * DEFLATE :: Streaming gzip with a small window and fixed Huffman codes
+ *
+ * Meant for text produced while a response is sent: memory stays small and
+ * constant, no code tables are built and each input byte costs a hash lookup
+ * and a short match search. Raw bytes are written straight into the window
+ * (input() and commit()), read() hands out the compressed stream.
+ * */
+
+class AsyncWebDeflate {
+  private:
+    uint8_t* _window;  // the history, then input not compressed yet
+    uint16_t* _head;   // hash of 3 bytes -> last position + 1
+    uint16_t* _prev;   // position -> previous position + 1 with the same hash
+    size_t _pos;       // next byte to compress
+    size_t _end;       // end of the input in _window
+    uint32_t _bits;
+    uint8_t _bitCount;
+    uint8_t _state;
+    uint32_t _crc;
+    uint32_t _size;
+    uint8_t _out[ASYNCWEBSERVER_DEFLATE_OUTPUT];
+    size_t _outStart;
+    size_t _outEnd;
+
+    void _putBits(uint32_t value, uint8_t count);
+    void _putCode(uint32_t code, uint8_t count); // Huffman codes go out most significant bit first
+    void _literal(uint8_t c);
+    void _match(size_t length, size_t distance);
+    void _insert(size_t pos);
+    size_t _longestMatch(size_t* distance);
+    void _compress();
+
+  public:
+    AsyncWebDeflate();
+    ~AsyncWebDeflate();
+
+    AsyncWebDeflate(AsyncWebDeflate const &) = delete;
+    AsyncWebDeflate &operator=(AsyncWebDeflate const &) = delete;
+
+    bool begin(); // false when out of memory
+
+    uint8_t* input(size_t* space); // where the next raw bytes go, no space until output is read
+    void commit(size_t len);       // len bytes were written to input()
+    void finish();                 // no more input, the stream is closed once read
+    size_t read(uint8_t* out, size_t len);
+    bool done() const;
+
+    // All of in at once, 0 when the result would not fit into outLen
+    static size_t gzip(const uint8_t* in, size_t len, uint8_t* out, size_t outLen);
+};
+
+#endif /* ASYNCWEBDEFLATE_H_ */
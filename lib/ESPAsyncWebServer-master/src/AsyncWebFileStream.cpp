@@ -0,0 +1,175 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ESPAsyncWebServer.h"
+#include "AsyncWebFileStream.h"
+
+#if defined(ESP32) && ASYNCWEBSERVER_FILE_READ_AHEAD > 0
+
+static QueueHandle_t _fills = NULL;
+static std::atomic<uint8_t> _streams(0);
+
+// Fills are taken in the order they were queued, so a stream's buffers are filled alternately
+static void _readerTask(void *pvParameters){
+  QueueHandle_t fills = (QueueHandle_t)pvParameters;
+  AsyncWebFileStream* stream;
+  for(;;){
+    if(xQueueReceive(fills, &stream, portMAX_DELAY) == pdPASS)
+      stream->_fill();
+  }
+}
+
+static bool _startReader(){
+  if(_fills)
+    return true;
+  // each stream has at most two fills queued, sending never has to wait for room
+  QueueHandle_t fills = xQueueCreate(2 * ASYNCWEBSERVER_FILE_STREAMS, sizeof(AsyncWebFileStream*));
+  if(fills == NULL)
+    return false;
+  if(xTaskCreate(_readerTask, "async_file", ASYNCWEBSERVER_FILE_READER_STACK, fills, ASYNCWEBSERVER_FILE_READER_PRIORITY, NULL) != pdPASS){
+    vQueueDelete(fills);
+    return false;
+  }
+  _fills = fills;
+  return true;
+}
+
+AsyncWebFileStream::AsyncWebFileStream(fs::File& file, size_t limit, AsyncClient* client)
+  : _file(file)
+  , _limit(limit)
+  , _client(client)
+  , _refs(1)
+  , _current(0)
+  , _pos(0)
+  , _fillIndex(0)
+{
+  for(uint8_t i = 0; i < 2; i++){
+    _ready[i] = false;
+    _length[i] = 0;
+    _data[i] = (uint8_t*)(this + 1) + i * ASYNCWEBSERVER_FILE_READ_AHEAD;
+  }
+}
+
+AsyncWebFileStream* AsyncWebFileStream::open(fs::File& file, size_t limit, AsyncClient* client){
+  if(!file || client == NULL)
+    return NULL;
+  if(_streams.fetch_add(1) >= ASYNCWEBSERVER_FILE_STREAMS){
+    _streams.fetch_sub(1);
+    return NULL;
+  }
+  void* mem = malloc(sizeof(AsyncWebFileStream) + 2 * ASYNCWEBSERVER_FILE_READ_AHEAD);
+  if(mem == NULL || !_startReader()){
+    free(mem);
+    _streams.fetch_sub(1);
+    return NULL;
+  }
+  AsyncWebFileStream* stream = new (mem) AsyncWebFileStream(file, limit, client);
+  file = fs::File(); // only the reader task touches it from now on
+  stream->_queueFill();
+  stream->_queueFill();
+  return stream;
+}
+
+bool AsyncWebFileStream::_queueFill(){
+  _refs.fetch_add(1, std::memory_order_relaxed);
+  AsyncWebFileStream* stream = this;
+  if(xQueueSend(_fills, &stream, 0) != pdPASS){
+    _refs.fetch_sub(1, std::memory_order_relaxed); // cannot happen while streams are limited, see _startReader()
+    return false;
+  }
+  return true;
+}
+
+void AsyncWebFileStream::_release(){
+  if(_refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+    _file.close();
+    this->~AsyncWebFileStream();
+    free(this);
+    _streams.fetch_sub(1);
+  }
+}
+
+void AsyncWebFileStream::_fill(){
+  uint8_t i = _fillIndex;
+  _fillIndex ^= 1;
+  size_t len = 0;
+  if(_client.load(std::memory_order_relaxed) && _limit){
+    len = _file.read(_data[i], std::min((size_t)ASYNCWEBSERVER_FILE_READ_AHEAD, _limit));
+    _limit = len ? _limit - len : 0;
+  }
+  _length[i] = len;
+  _ready[i].store(true, std::memory_order_release);
+  // the fill's reference goes with the wake, when the queue is full the next poll sends the data
+  if(!AsyncClient::call(_wake, this))
+    _release();
+}
+
+// close() runs on the async task too, a client still set here is still connected
+void AsyncWebFileStream::_wake(void* arg){
+  AsyncWebFileStream* stream = (AsyncWebFileStream*)arg;
+  AsyncClient* client = stream->_client.load(std::memory_order_relaxed);
+  if(client && client->pcb())
+    AsyncClient::_s_poll(client, client->pcb());
+  stream->_release();
+}
+
+size_t AsyncWebFileStream::read(uint8_t* data, size_t len){
+  size_t n = 0;
+  while(n < len && _ready[_current].load(std::memory_order_acquire)){
+    size_t available = _length[_current] - _pos;
+    if(available == 0)
+      break; // the end, no more fills
+    size_t m = std::min(len - n, available);
+    memcpy(data + n, _data[_current] + _pos, m);
+    n += m;
+    _pos += m;
+    if(_pos == _length[_current]){
+      // sent from, give it back to the reader
+      _ready[_current].store(false, std::memory_order_relaxed);
+      _queueFill();
+      _current ^= 1;
+      _pos = 0;
+    }
+  }
+  if(n || (_ready[_current].load(std::memory_order_acquire) && _length[_current] == 0))
+    return n;
+  return RESPONSE_TRY_AGAIN;
+}
+
+void AsyncWebFileStream::close(){
+  _client.store(NULL, std::memory_order_relaxed);
+  _release();
+}
+
+#else
+
+AsyncWebFileStream* AsyncWebFileStream::open(fs::File& file, size_t limit, AsyncClient* client){
+  (void)file;
+  (void)limit;
+  (void)client;
+  return NULL;
+}
+
+size_t AsyncWebFileStream::read(uint8_t* data, size_t len){ (void)data; (void)len; return 0; }
+void AsyncWebFileStream::close(){}
+void AsyncWebFileStream::_fill(){}
+void AsyncWebFileStream::_wake(void* arg){ (void)arg; }
+
+#endif
@@ -0,0 +1,91 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASYNCWEBFILESTREAM_H_
+#define ASYNCWEBFILESTREAM_H_
+
+#include "Arduino.h"
+#include "FS.h"
+#include <atomic>
+
+class AsyncClient;
+
+// Size of each of the two read-ahead buffers of a file stream, 0 reads files on the async_tcp task as before
+#ifndef ASYNCWEBSERVER_FILE_READ_AHEAD
+#ifdef ESP32
+#define ASYNCWEBSERVER_FILE_READ_AHEAD 4096
+#else
+#define ASYNCWEBSERVER_FILE_READ_AHEAD 0
+#endif
+#endif
+
+// File responses read ahead at the same time, more are read inline
+#ifndef ASYNCWEBSERVER_FILE_STREAMS
+#define ASYNCWEBSERVER_FILE_STREAMS 4
+#endif
+
+// The reading task, started with the first stream
+#ifndef ASYNCWEBSERVER_FILE_READER_STACK
+#define ASYNCWEBSERVER_FILE_READER_STACK 4096
+#endif
+#ifndef ASYNCWEBSERVER_FILE_READER_PRIORITY
+#define ASYNCWEBSERVER_FILE_READER_PRIORITY 2
+#endif
+
+/*
+ * FILE STREAM :: A file read ahead of the response sending it, on a task of its own
+ *
+ * A slow read (an SD card, SPIFFS collecting garbage) would otherwise stall the
+ * async_tcp task and every connection on it. The stream takes over the file and
+ * two buffers: the reader task fills one while the response sends from the
+ * other. read() never touches the file, when nothing is ready it returns
+ * RESPONSE_TRY_AGAIN and the client is woken once the next fill is done.
+ * */
+
+class AsyncWebFileStream {
+  private:
+    fs::File _file;
+    size_t _limit;                 // bytes still to read from the file
+    std::atomic<AsyncClient*> _client; // polled after each fill, NULL once closed
+    std::atomic<uint8_t> _refs;    // the response, every queued fill and every pending wake
+    std::atomic<bool> _ready[2];
+    size_t _length[2];             // 0 in a ready buffer is the end of the file
+    uint8_t* _data[2];
+    uint8_t _current;              // the buffer read() takes from
+    size_t _pos;
+    uint8_t _fillIndex;            // the buffer the next fill goes to, reader task only
+    AsyncWebFileStream(fs::File& file, size_t limit, AsyncClient* client);
+    ~AsyncWebFileStream() {}
+    bool _queueFill();
+    void _release();
+    static void _wake(void* arg); // on the async task
+
+  public:
+    AsyncWebFileStream(AsyncWebFileStream const &) = delete;
+    AsyncWebFileStream &operator=(AsyncWebFileStream const &) = delete;
+
+    // Takes over file on success, NULL leaves it with the caller to be read inline
+    static AsyncWebFileStream* open(fs::File& file, size_t limit, AsyncClient* client);
+    size_t read(uint8_t* data, size_t len); // 0 at the end
+    void close(); // the response is done, the stream goes once the reader is
+    void _fill(); // on the reader task
+};
+
+#endif /* ASYNCWEBFILESTREAM_H_ */
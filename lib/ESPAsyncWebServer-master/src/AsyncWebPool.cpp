@@ -0,0 +1,84 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "AsyncWebPool.h"
+#include <stdlib.h>
+
+AsyncWebPool* AsyncWebPool::_pools = nullptr;
+
+AsyncWebPool::AsyncWebPool(size_t slotSize, size_t capacity)
+  : _slots(nullptr)
+  , _slotSize((slotSize + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+  , _capacity(0)
+  , _free(nullptr)
+  , _freeCount(0)
+  , _next(nullptr)
+{
+  _slots = (uint8_t*)malloc(_slotSize * capacity);
+  _free = (void**)malloc(sizeof(void*) * capacity);
+  if(_slots == NULL || _free == NULL){
+    free(_slots);
+    free(_free);
+    _slots = nullptr;
+    _free = nullptr;
+    return;
+  }
+  _capacity = capacity;
+  for(size_t i = 0; i < capacity; i++)
+    _free[i] = _slots + ((capacity - 1 - i) * _slotSize);
+  _freeCount = capacity;
+  _next = _pools;
+  _pools = this;
+}
+
+AsyncWebPool::~AsyncWebPool(){
+  AsyncWebPool** p = &_pools;
+  while(*p && *p != this)
+    p = &(*p)->_next;
+  if(*p)
+    *p = _next;
+  free(_slots);
+  free(_free);
+}
+
+bool AsyncWebPool::_owns(const void* ptr) const {
+  return _slots && (const uint8_t*)ptr >= _slots && (const uint8_t*)ptr < _slots + (_slotSize * _capacity);
+}
+
+void* AsyncWebPool::take(){
+  if(!_freeCount)
+    return nullptr;
+  return _free[--_freeCount];
+}
+
+bool AsyncWebPool::give(void* ptr){
+  if(!_owns(ptr))
+    return false;
+  _free[_freeCount++] = ptr;
+  return true;
+}
+
+bool AsyncWebPool::release(void* ptr){
+  for(AsyncWebPool* p = _pools; p; p = p->_next){
+    if(p->give(ptr))
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,63 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASYNCWEBPOOL_H_
+#define ASYNCWEBPOOL_H_
+
+#include "stddef.h"
+#include <stdint.h>
+
+/*
+ * POOL :: Fixed number of equally sized slots reserved up front
+ *
+ * take() and give() are O(1). Objects are constructed into a slot with
+ * placement new and returned through release() from the operator delete
+ * of pooled classes, which finds the owning pool by address.
+ * */
+
+class AsyncWebPool {
+  private:
+    uint8_t* _slots;
+    size_t _slotSize;
+    size_t _capacity;
+    void** _free;
+    size_t _freeCount;
+    AsyncWebPool* _next;
+    static AsyncWebPool* _pools;
+    bool _owns(const void* ptr) const;
+
+  public:
+    AsyncWebPool(size_t slotSize, size_t capacity);
+    ~AsyncWebPool();
+
+    AsyncWebPool(AsyncWebPool const &) = delete;
+    AsyncWebPool &operator=(AsyncWebPool const &) = delete;
+
+    bool valid() const { return _slots != nullptr; }
+    size_t capacity() const { return _capacity; }
+    size_t available() const { return _freeCount; }
+    void* take();
+    bool give(void* ptr);
+
+    // Return ptr to whichever pool it came from, false if it is not pooled memory
+    static bool release(void* ptr);
+};
+
+#endif /* ASYNCWEBPOOL_H_ */
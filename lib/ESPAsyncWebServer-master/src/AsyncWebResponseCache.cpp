@@ -0,0 +1,166 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ESPAsyncWebServer.h"
+#include "WebResponseImpl.h"
+
+AsyncWebResponseCache::AsyncWebResponseCache(const String& contentType, VersionFunction version, RenderFunction render)
+  : _contentType(contentType)
+  , _version(version)
+  , _render(render)
+  , _params()
+  , _gzip(false)
+  , _generation(0)
+  , _cachedVersion(0)
+  , _cachedGeneration(0)
+  , _clock(0)
+  , _hits(0)
+  , _renders(0)
+{
+  for(auto& entry: _entries){
+    entry.body = NULL;
+    entry.gzip = NULL;
+    entry.used = 0;
+  }
+}
+
+AsyncWebResponseCache::~AsyncWebResponseCache(){
+  _clear();
+}
+
+AsyncWebResponseCache& AsyncWebResponseCache::setParams(const char* params){
+  _params = params ? params : "";
+  invalidate();
+  return *this;
+}
+
+AsyncWebResponseCache& AsyncWebResponseCache::setGzip(bool gzip){
+  _gzip = gzip;
+  invalidate();
+  return *this;
+}
+
+void AsyncWebResponseCache::_clear(){
+  for(auto& entry: _entries){
+    if(entry.body)
+      entry.body->release();
+    if(entry.gzip)
+      entry.gzip->release();
+    entry.body = NULL;
+    entry.gzip = NULL;
+    entry.key = String();
+  }
+}
+
+String AsyncWebResponseCache::_key(AsyncWebServerRequest *request) const {
+  String key = String((unsigned)request->method());
+  key += ' ';
+  key += request->url();
+  int start = 0;
+  while(start < (int)_params.length()){
+    int end = _params.indexOf(',', start);
+    if(end < 0)
+      end = _params.length();
+    String name = _params.substring(start, end);
+    name.trim();
+    start = end + 1;
+    AsyncWebParameter* param = name.length() ? request->getParam(name) : NULL;
+    if(param){
+      key += '\n';
+      key += name;
+      key += '=';
+      key += param->value();
+    }
+  }
+  return key;
+}
+
+AsyncWebResponseCache::Entry* AsyncWebResponseCache::_fill(AsyncWebServerRequest *request, const String& key){
+  AsyncWebSharedBuffer* body = _render ? _render(request) : NULL;
+  if(body == NULL)
+    return NULL;
+  _renders++;
+
+  // compressed once per version
+  AsyncWebSharedBuffer* gzip = (_gzip && body->length() >= ASYNCWEBSERVER_GZIP_THRESHOLD) ? body->gzip() : NULL;
+
+  // an empty slot, or the one used longest ago
+  Entry* entry = &_entries[0];
+  for(auto& e: _entries){
+    if(e.body == NULL){
+      entry = &e;
+      break;
+    }
+    if(e.used < entry->used)
+      entry = &e;
+  }
+  if(entry->body)
+    entry->body->release();
+  if(entry->gzip)
+    entry->gzip->release();
+  entry->key = key;
+  entry->body = body;
+  entry->gzip = gzip;
+  body->etag(entry->etag, sizeof(entry->etag));
+  if(gzip)
+    body->etag(entry->gzipEtag, sizeof(entry->gzipEtag), "-gz");
+  return entry;
+}
+
+void AsyncWebResponseCache::send(AsyncWebServerRequest *request){
+  // taken first, data changing while rendering makes the next send() render again
+  uint32_t version = _version ? _version() : 0;
+  uint32_t generation = _generation.load(std::memory_order_acquire);
+  if(version != _cachedVersion || generation != _cachedGeneration){
+    _clear();
+    _cachedVersion = version;
+    _cachedGeneration = generation;
+  }
+
+  String key = _key(request);
+  Entry* entry = NULL;
+  for(auto& e: _entries){
+    if(e.body && e.key == key){
+      entry = &e;
+      break;
+    }
+  }
+  if(entry)
+    _hits++;
+  else if((entry = _fill(request, key)) == NULL)
+    return request->send(500);
+  entry->used = ++_clock;
+
+  bool gzip = entry->gzip && request->acceptsGzip();
+  const char* etag = gzip ? entry->gzipEtag : entry->etag;
+  AsyncWebServerResponse* response;
+  if(request->etagMatches(etag)){
+    response = request->beginResponse(304);
+  } else {
+    response = request->beginResponse(200, _contentType, gzip ? entry->gzip : entry->body);
+    if(gzip)
+      response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", "no-cache"); // always revalidated, an unchanged version costs a 304
+  if(_gzip)
+    response->addHeader("Vary", "Accept-Encoding");
+  request->send(response);
+}
@@ -0,0 +1,97 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASYNCWEBRESPONSECACHE_H_
+#define ASYNCWEBRESPONSECACHE_H_
+
+#include "Arduino.h"
+#include <atomic>
+#include <functional>
+
+class AsyncWebServerRequest;
+class AsyncWebSharedBuffer;
+
+// Bodies one AsyncWebResponseCache keeps, one per method, URL and set of parameter values
+#ifndef ASYNCWEBSERVER_RESPONSE_CACHE_ENTRIES
+#define ASYNCWEBSERVER_RESPONSE_CACHE_ENTRIES 4
+#endif
+
+/*
+ * RESPONSE CACHE :: Finished bodies of a route, rendered once per data version
+ *
+ * send() looks a request up by method, URL and the query parameters named in
+ * setParams(). On a miss render() produces the body; until the data version
+ * changes every request for the same key is answered from the stored buffer
+ * in a single write, gzip compressed for the clients that accept it when
+ * setGzip(true) is set. A new version(), or invalidate(), drops all entries.
+ *
+ * Requests are handled on the server's task one after the other, so misses
+ * that arrive together are served by the render of the first. The version
+ * may change from any task.
+ * */
+
+class AsyncWebResponseCache {
+  public:
+    typedef std::function<uint32_t(void)> VersionFunction;
+    // the body for the request with one reference handed to the cache, NULL answers 500
+    typedef std::function<AsyncWebSharedBuffer*(AsyncWebServerRequest *request)> RenderFunction;
+
+  private:
+    struct Entry {
+      String key;
+      AsyncWebSharedBuffer* body;
+      AsyncWebSharedBuffer* gzip; // NULL when compressing did not pay off
+      char etag[11];
+      char gzipEtag[14];
+      uint32_t used;
+    };
+    String _contentType;
+    VersionFunction _version;
+    RenderFunction _render;
+    String _params;
+    bool _gzip;
+    Entry _entries[ASYNCWEBSERVER_RESPONSE_CACHE_ENTRIES];
+    std::atomic<uint32_t> _generation;
+    uint32_t _cachedVersion;
+    uint32_t _cachedGeneration;
+    uint32_t _clock;
+    uint32_t _hits;
+    uint32_t _renders;
+    String _key(AsyncWebServerRequest *request) const;
+    Entry* _fill(AsyncWebServerRequest *request, const String& key);
+    void _clear();
+
+  public:
+    AsyncWebResponseCache(const String& contentType, VersionFunction version, RenderFunction render);
+    ~AsyncWebResponseCache();
+
+    AsyncWebResponseCache(AsyncWebResponseCache const &) = delete;
+    AsyncWebResponseCache &operator=(AsyncWebResponseCache const &) = delete;
+
+    AsyncWebResponseCache& setParams(const char* params); // comma separated names of the query parameters render() reads
+    AsyncWebResponseCache& setGzip(bool gzip);
+    void invalidate(){ _generation.fetch_add(1, std::memory_order_release); }
+    void send(AsyncWebServerRequest *request);
+
+    uint32_t hits() const { return _hits; }
+    uint32_t renders() const { return _renders; }
+};
+
+#endif /* ASYNCWEBRESPONSECACHE_H_ */
@@ -0,0 +1,100 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ESPAsyncWebServer.h"
+#include "AsyncWebSynchronization.h"
+#include "AsyncWebDeflate.h"
+
+// Guards the swap in publish() against the pointer load + retain in acquire(), shared by all bodies
+static AsyncWebLock _publishLock;
+
+AsyncWebSharedBuffer* AsyncWebSharedBuffer::create(const uint8_t* data, size_t len){
+  void* mem = malloc(sizeof(AsyncWebSharedBuffer) + len);
+  if(mem == NULL)
+    return NULL;
+  AsyncWebSharedBuffer* buffer = new (mem) AsyncWebSharedBuffer(len);
+  if(data && len)
+    memcpy((uint8_t*)mem + sizeof(AsyncWebSharedBuffer), data, len);
+  return buffer;
+}
+
+AsyncWebSharedBuffer* AsyncWebSharedBuffer::create(const char* str){
+  return create((const uint8_t*)str, str ? strlen(str) : 0);
+}
+
+void AsyncWebSharedBuffer::etag(char* out, size_t size, const char* suffix) const {
+  // FNV-1a of the bytes
+  uint32_t hash = 2166136261UL;
+  for(size_t i = 0; i < _len; i++)
+    hash = (hash ^ data()[i]) * 16777619UL;
+  snprintf(out, size, "\"%08x%s\"", (unsigned)hash, suffix);
+}
+
+AsyncWebSharedBuffer* AsyncWebSharedBuffer::gzip() const {
+  AsyncWebSharedBuffer* scratch = create(NULL, _len);
+  if(scratch == NULL)
+    return NULL;
+  size_t len = AsyncWebDeflate::gzip(data(), _len, scratch->data(), scratch->length());
+  AsyncWebSharedBuffer* compressed = len ? create(scratch->data(), len) : NULL;
+  scratch->release();
+  return compressed;
+}
+
+void AsyncWebSharedBuffer::release(){
+  if(_refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+    this->~AsyncWebSharedBuffer();
+    free(this);
+  }
+}
+
+AsyncWebSharedBody::~AsyncWebSharedBody(){
+  if(_current)
+    _current->release();
+}
+
+bool AsyncWebSharedBody::publish(const uint8_t* data, size_t len){
+  AsyncWebSharedBuffer* buffer = AsyncWebSharedBuffer::create(data, len);
+  if(buffer == NULL)
+    return false;
+  publish(buffer);
+  return true;
+}
+
+bool AsyncWebSharedBody::publish(const char* str){
+  return publish((const uint8_t*)str, str ? strlen(str) : 0);
+}
+
+void AsyncWebSharedBody::publish(AsyncWebSharedBuffer* buffer){
+  AsyncWebSharedBuffer* old;
+  {
+    AsyncWebLockGuard l(_publishLock);
+    old = _current;
+    _current = buffer;
+    _version.fetch_add(1, std::memory_order_release);
+  }
+  // dropped outside the lock
+  if(old)
+    old->release();
+}
+
+AsyncWebSharedBuffer* AsyncWebSharedBody::acquire() const {
+  AsyncWebLockGuard l(_publishLock);
+  return _current ? _current->retain() : NULL;
+}
@@ -0,0 +1,87 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASYNCWEBSHAREDBUFFER_H_
+#define ASYNCWEBSHAREDBUFFER_H_
+
+#include "stddef.h"
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * SHARED BUFFER :: Immutable bytes sent by any number of responses at once
+ *
+ * The bytes follow the header in a single allocation. create() returns the
+ * buffer holding one reference, every user takes its own with retain() and
+ * gives it back with release(), the last release() frees it.
+ * */
+
+class AsyncWebSharedBuffer {
+  private:
+    std::atomic<uint32_t> _refs;
+    size_t _len;
+    AsyncWebSharedBuffer(size_t len) : _refs(1), _len(len) {}
+    ~AsyncWebSharedBuffer() {}
+
+  public:
+    AsyncWebSharedBuffer(AsyncWebSharedBuffer const &) = delete;
+    AsyncWebSharedBuffer &operator=(AsyncWebSharedBuffer const &) = delete;
+
+    static AsyncWebSharedBuffer* create(const uint8_t* data, size_t len); // data NULL leaves the bytes to be filled in
+    static AsyncWebSharedBuffer* create(const char* str);
+
+    const uint8_t* data() const { return (const uint8_t*)(this + 1); }
+    uint8_t* data() { return (uint8_t*)(this + 1); } // only while filling a new buffer, before it is shared
+    size_t length() const { return _len; }
+    void etag(char* out, size_t size, const char* suffix = "") const; // quoted, the same bytes always get the same tag
+    AsyncWebSharedBuffer* gzip() const; // compressed copy of the exact size, NULL when it does not get smaller
+    AsyncWebSharedBuffer* retain(){ _refs.fetch_add(1, std::memory_order_relaxed); return this; }
+    void release(); // drops the caller's reference only, responses still sending the bytes hold their own
+};
+
+/*
+ * SHARED BODY :: The current version of a body that is published from another task
+ *
+ * publish() swaps in a new buffer, responses that already hold the old one
+ * keep sending it until they are done. acquire() returns the current buffer
+ * with a reference taken for the caller, or NULL if nothing was published yet.
+ * version() counts the publishes, e.g. for an AsyncWebResponseCache.
+ * */
+
+class AsyncWebSharedBody {
+  private:
+    AsyncWebSharedBuffer* _current;
+    std::atomic<uint32_t> _version;
+
+  public:
+    AsyncWebSharedBody() : _current(nullptr), _version(0) {}
+    ~AsyncWebSharedBody();
+
+    AsyncWebSharedBody(AsyncWebSharedBody const &) = delete;
+    AsyncWebSharedBody &operator=(AsyncWebSharedBody const &) = delete;
+
+    bool publish(const uint8_t* data, size_t len);
+    bool publish(const char* str);
+    void publish(AsyncWebSharedBuffer* buffer); // takes over the caller's reference
+    AsyncWebSharedBuffer* acquire() const;
+    uint32_t version() const { return _version.load(std::memory_order_acquire); }
+};
+
+#endif /* ASYNCWEBSHAREDBUFFER_H_ */
@@ -1280,8 +1280,7 @@ void AsyncWebSocketResponse::_respond(AsyncWebServerRequest *request){
     request->client()->close(true);
     return;
   }
-  String out = _assembleHead(request->version());
-  request->client()->write(out.c_str(), _headLength);
+  _sendHead(request);
   _state = RESPONSE_WAIT_ACK;
 }
 
@@ -0,0 +1,379 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ESPAsyncWebServer.h"
+#include "WebResponseImpl.h"
+
+AsyncWebTemplate::AsyncWebTemplate()
+  : _refs(1)
+  , _text(NULL)
+  , _textLength(0)
+  , _segments(NULL)
+  , _segmentCount(0)
+  , _names(NULL)
+  , _nameCount(0)
+{}
+
+AsyncWebTemplate::~AsyncWebTemplate(){
+  free(_text);
+  free(_segments);
+  delete[] _names;
+}
+
+void AsyncWebTemplate::release(){
+  if(_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete this;
+}
+
+/*
+ * Parses data in place, the literals are compacted towards the front as
+ * placeholders are cut out. data becomes the text of the template.
+ *
+ * %name% is a placeholder when the name has 1 to TEMPLATE_PARAM_NAME_LENGTH
+ * characters, %% is a literal %, any other % is kept as it is.
+ * */
+bool AsyncWebTemplate::_parse(uint8_t* data, size_t len){
+  size_t marks = 0;
+  for(const uint8_t* p = data; (p = (const uint8_t*)memchr(p, TEMPLATE_PLACEHOLDER, data + len - p)) != NULL; p++)
+    marks++;
+
+  // every placeholder takes two marks
+  _segments = (Segment*)malloc(sizeof(Segment) * (marks / 2 + 1));
+  if(_segments == NULL)
+    return false;
+  if(marks > 1){
+    _names = new String[marks / 2];
+    if(_names == NULL)
+      return false;
+  }
+
+  size_t r = 0;
+  size_t w = 0;
+  size_t literal = 0;
+  while(r < len){
+    const uint8_t* mark = (const uint8_t*)memchr(data + r, TEMPLATE_PLACEHOLDER, len - r);
+    size_t next = mark ? (mark - data) : len;
+    memmove(data + w, data + r, next - r);
+    w += next - r;
+    r = next;
+    if(r == len)
+      break;
+
+    size_t window = len - r - 1;
+    if(window > TEMPLATE_PARAM_NAME_LENGTH + 1)
+      window = TEMPLATE_PARAM_NAME_LENGTH + 1;
+    uint8_t* close = (uint8_t*)memchr(data + r + 1, TEMPLATE_PLACEHOLDER, window);
+    if(close == NULL || close == data + r + 1){
+      // lone % as it is, %% as a single one
+      data[w++] = TEMPLATE_PLACEHOLDER;
+      r += close ? 2 : 1;
+      continue;
+    }
+
+    *close = 0; // the closing mark is consumed anyway
+    const char* name = (const char*)data + r + 1;
+    size_t index = 0;
+    while(index < _nameCount && !_names[index].equals(name))
+      index++;
+    if(index == _nameCount)
+      _names[_nameCount++] = name;
+
+    _segments[_segmentCount].offset = literal;
+    _segments[_segmentCount].length = w - literal;
+    _segments[_segmentCount].name = index;
+    _segmentCount++;
+    literal = w;
+    r = close - data + 1;
+  }
+  _segments[_segmentCount].offset = literal;
+  _segments[_segmentCount].length = w - literal;
+  _segments[_segmentCount].name = -1;
+  _segmentCount++;
+
+  _text = data;
+  _textLength = w;
+  return true;
+}
+
+AsyncWebTemplate* AsyncWebTemplate::compile(const uint8_t* data, size_t len){
+  uint8_t* copy = (uint8_t*)malloc(len ? len : 1);
+  if(copy == NULL)
+    return NULL;
+  memcpy(copy, data, len);
+  AsyncWebTemplate* tpl = new AsyncWebTemplate();
+  if(!tpl->_parse(copy, len)){
+    if(tpl->_text == NULL)
+      free(copy);
+    tpl->release();
+    return NULL;
+  }
+  return tpl;
+}
+
+AsyncWebTemplate* AsyncWebTemplate::compile(fs::File& file){
+  size_t len = file.size();
+  if(len > ASYNCWEBSERVER_TEMPLATE_MAX_SIZE)
+    return NULL;
+  uint8_t* data = (uint8_t*)malloc(len ? len : 1);
+  if(data == NULL)
+    return NULL;
+  size_t got = 0;
+  file.seek(0);
+  while(got < len){
+    size_t n = file.read(data + got, len - got);
+    if(!n)
+      break;
+    got += n;
+  }
+  file.seek(0);
+  AsyncWebTemplate* tpl = NULL;
+  if(got == len){
+    tpl = new AsyncWebTemplate();
+    if(!tpl->_parse(data, len)){
+      tpl->release();
+      tpl = NULL;
+    }
+  }
+  if(tpl == NULL){
+    free(data);
+    return NULL;
+  }
+  // text never grows back, give the space taken by the placeholders back to the heap
+  if(tpl->_textLength < len){
+    uint8_t* shrunk = (uint8_t*)realloc(tpl->_text, tpl->_textLength ? tpl->_textLength : 1);
+    if(shrunk != NULL)
+      tpl->_text = shrunk;
+  }
+  return tpl;
+}
+
+size_t AsyncWebTemplate::render(const String* values, uint8_t* out) const {
+  size_t len = 0;
+  for(size_t i = 0; i < _segmentCount; i++){
+    const Segment& segment = _segments[i];
+    if(out)
+      memcpy(out + len, _text + segment.offset, segment.length);
+    len += segment.length;
+    if(segment.name >= 0){
+      const String& value = values[segment.name];
+      if(out)
+        memcpy(out + len, value.c_str(), value.length());
+      len += value.length();
+    }
+  }
+  return len;
+}
+
+/*
+ * Cache of compiled file templates, most recently used first
+ * */
+
+struct AsyncWebTemplateCacheEntry {
+  String key;
+  time_t mtime;
+  size_t size;
+  AsyncWebTemplate* tpl;
+  AsyncWebTemplateCacheEntry* next;
+};
+
+static AsyncWebTemplateCacheEntry* _templateCache = NULL;
+
+AsyncWebTemplate* AsyncWebTemplate::forFile(fs::File& file, const String& key){
+  if(!ASYNCWEBSERVER_TEMPLATE_CACHE)
+    return compile(file);
+
+  time_t mtime = file.getLastWrite();
+  size_t size = file.size();
+  AsyncWebTemplateCacheEntry** link = &_templateCache;
+  AsyncWebTemplateCacheEntry* entry = NULL;
+  size_t count = 0;
+  while(*link){
+    if((*link)->key == key){
+      entry = *link;
+      *link = entry->next;
+      break;
+    }
+    link = &(*link)->next;
+    count++;
+  }
+
+  if(entry != NULL && (entry->mtime != mtime || entry->size != size)){
+    // the file changed, responses still rendering the old template keep their reference
+    entry->tpl->release();
+    entry->tpl = NULL;
+  }
+  if(entry == NULL || entry->tpl == NULL){
+    AsyncWebTemplate* tpl = compile(file);
+    if(tpl == NULL){
+      delete entry;
+      return NULL;
+    }
+    if(entry == NULL){
+      entry = new AsyncWebTemplateCacheEntry();
+      entry->key = key;
+    }
+    entry->mtime = mtime;
+    entry->size = size;
+    entry->tpl = tpl;
+  }
+  entry->next = _templateCache;
+  _templateCache = entry;
+
+  // drop whatever falls off the end
+  AsyncWebTemplateCacheEntry* last = _templateCache;
+  for(count = 1; last->next && count < ASYNCWEBSERVER_TEMPLATE_CACHE; count++)
+    last = last->next;
+  while(last->next){
+    AsyncWebTemplateCacheEntry* dropped = last->next;
+    last->next = dropped->next;
+    dropped->tpl->release();
+    delete dropped;
+  }
+  return entry->tpl->retain();
+}
+
+void AsyncWebTemplate::flush(){
+  while(_templateCache){
+    AsyncWebTemplateCacheEntry* entry = _templateCache;
+    _templateCache = entry->next;
+    entry->tpl->release();
+    delete entry;
+  }
+}
+
+/*
+ * Render cache
+ * */
+
+AsyncWebRenderCache::AsyncWebRenderCache(const String& path, std::function<String(const String&)> processor)
+  : _path(path)
+  , _data(NULL)
+  , _dataLength(0)
+  , _processor(processor)
+  , _version(1)
+  , _renderedVersion(0)
+  , _rendered(NULL)
+  , _renderedGzip(NULL)
+  , _gzip(false)
+{
+  _etag[0] = 0;
+  _gzipEtag[0] = 0;
+}
+
+AsyncWebRenderCache::AsyncWebRenderCache(const uint8_t* data, size_t len, std::function<String(const String&)> processor)
+  : _data(data)
+  , _dataLength(len)
+  , _processor(processor)
+  , _version(1)
+  , _renderedVersion(0)
+  , _rendered(NULL)
+  , _renderedGzip(NULL)
+  , _gzip(false)
+{
+  _etag[0] = 0;
+  _gzipEtag[0] = 0;
+}
+
+AsyncWebRenderCache::~AsyncWebRenderCache(){
+  if(_rendered)
+    _rendered->release();
+  if(_renderedGzip)
+    _renderedGzip->release();
+}
+
+AsyncWebRenderCache& AsyncWebRenderCache::setGzip(bool gzip){
+  _gzip = gzip;
+  invalidate();
+  return *this;
+}
+
+bool AsyncWebRenderCache::_render(fs::FS* fs){
+  // taken first, values changing while rendering make the next send() render again
+  uint32_t version = this->version();
+  AsyncWebTemplate* tpl;
+  if(_data){
+    tpl = AsyncWebTemplate::compile(_data, _dataLength);
+  } else {
+    if(fs == NULL)
+      return false;
+    File file = fs->open(_path, "r");
+    if(!file)
+      return false;
+    tpl = AsyncWebTemplate::forFile(file, _path);
+    file.close();
+  }
+  if(tpl == NULL)
+    return false;
+
+  String* values = tpl->nameCount() ? new String[tpl->nameCount()] : NULL;
+  for(size_t i = 0; i < tpl->nameCount(); i++)
+    values[i] = _processor ? _processor(tpl->name(i)) : String();
+  AsyncWebSharedBuffer* rendered = AsyncWebSharedBuffer::create(NULL, tpl->render(values, NULL));
+  if(rendered != NULL)
+    tpl->render(values, rendered->data());
+  delete[] values;
+  tpl->release();
+  if(rendered == NULL)
+    return false;
+
+  rendered->etag(_etag, sizeof(_etag));
+  // compressed once per render, not per request
+  AsyncWebSharedBuffer* compressed = (_gzip && rendered->length() >= ASYNCWEBSERVER_GZIP_THRESHOLD) ? rendered->gzip() : NULL;
+  if(compressed)
+    rendered->etag(_gzipEtag, sizeof(_gzipEtag), "-gz");
+
+  if(_rendered)
+    _rendered->release();
+  if(_renderedGzip)
+    _renderedGzip->release();
+  _rendered = rendered;
+  _renderedGzip = compressed;
+  _renderedVersion = version;
+  return true;
+}
+
+void AsyncWebRenderCache::send(AsyncWebServerRequest *request, fs::FS& fs, const String& contentType){
+  _send(request, &fs, contentType);
+}
+
+void AsyncWebRenderCache::send(AsyncWebServerRequest *request, const String& contentType){
+  _send(request, NULL, contentType);
+}
+
+void AsyncWebRenderCache::_send(AsyncWebServerRequest *request, fs::FS* fs, const String& contentType){
+  if((_rendered == NULL || _renderedVersion != version()) && !_render(fs) && _rendered == NULL)
+    return request->send(404);
+
+  bool gzip = _renderedGzip && request->acceptsGzip();
+  const char* etag = gzip ? _gzipEtag : _etag;
+  AsyncWebServerResponse* response;
+  if(request->etagMatches(etag)){
+    response = request->beginResponse(304);
+  } else {
+    response = request->beginResponse(200, contentType, gzip ? _renderedGzip : _rendered);
+    response->addHeader("Cache-Control", "no-cache"); // always revalidated, unchanged values cost a 304
+    if(gzip)
+      response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("ETag", etag);
+  if(_gzip)
+    response->addHeader("Vary", "Accept-Encoding");
+  request->send(response);
+}
@@ -0,0 +1,139 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASYNCWEBTEMPLATE_H_
+#define ASYNCWEBTEMPLATE_H_
+
+#include "Arduino.h"
+#include "FS.h"
+#include <atomic>
+#include <functional>
+
+class AsyncWebServerRequest;
+class AsyncWebSharedBuffer;
+
+// Compiled file templates kept around, checked against the file size and mtime on every use
+#ifndef ASYNCWEBSERVER_TEMPLATE_CACHE
+#define ASYNCWEBSERVER_TEMPLATE_CACHE 4
+#endif
+
+// Larger templates are not compiled, they are processed while streaming as before
+#ifndef ASYNCWEBSERVER_TEMPLATE_MAX_SIZE
+#define ASYNCWEBSERVER_TEMPLATE_MAX_SIZE 16384
+#endif
+
+/*
+ * TEMPLATE :: A template parsed once into literal text and placeholder references
+ *
+ * The literals of all segments are stored back to back with %% already
+ * unescaped. Each segment is a literal run followed by a placeholder, given
+ * as an index into the distinct names; the last segment has none. Templates
+ * are reference counted so a cached one can be replaced while responses are
+ * still rendering it.
+ * */
+
+class AsyncWebTemplate {
+  public:
+    struct Segment {
+      uint32_t offset;
+      uint32_t length;
+      int16_t name; // -1 for the trailing literal
+    };
+
+  private:
+    std::atomic<uint32_t> _refs;
+    uint8_t* _text;
+    size_t _textLength;
+    Segment* _segments;
+    size_t _segmentCount;
+    String* _names;
+    size_t _nameCount;
+
+    AsyncWebTemplate();
+    ~AsyncWebTemplate();
+    bool _parse(uint8_t* data, size_t len);
+
+  public:
+    AsyncWebTemplate(AsyncWebTemplate const &) = delete;
+    AsyncWebTemplate &operator=(AsyncWebTemplate const &) = delete;
+
+    static AsyncWebTemplate* compile(const uint8_t* data, size_t len);
+    static AsyncWebTemplate* compile(fs::File& file);
+    // Compiled template of file, from the cache while key, size and mtime still match
+    static AsyncWebTemplate* forFile(fs::File& file, const String& key);
+    static void flush();
+
+    const uint8_t* text() const { return _text; }
+    size_t textLength() const { return _textLength; }
+    const Segment& segment(size_t index) const { return _segments[index]; }
+    size_t segmentCount() const { return _segmentCount; }
+    const String& name(size_t index) const { return _names[index]; }
+    size_t nameCount() const { return _nameCount; }
+
+    // Writes the template with values[i] in place of name(i), out NULL only returns the length
+    size_t render(const String* values, uint8_t* out) const;
+
+    AsyncWebTemplate* retain(){ _refs.fetch_add(1, std::memory_order_relaxed); return this; }
+    void release();
+};
+
+/*
+ * RENDER CACHE :: The output of one file template, rendered again only when its values change
+ *
+ * invalidate() may be called from any task, typically by whatever publishes
+ * the values. The next send() renders the template into a shared buffer that
+ * all responses send as it is, with an ETag hashed from the rendered bytes,
+ * or its gzip copy made in the same render when setGzip(true) is set.
+ * The file itself is not checked again until the next invalidate(). The
+ * template may also be given as data compiled into the firmware.
+ * */
+
+class AsyncWebRenderCache {
+  private:
+    String _path;
+    const uint8_t* _data; // template in memory instead of _path
+    size_t _dataLength;
+    std::function<String(const String&)> _processor;
+    std::atomic<uint32_t> _version;
+    uint32_t _renderedVersion;
+    AsyncWebSharedBuffer* _rendered;
+    AsyncWebSharedBuffer* _renderedGzip; // NULL when not wanted or compressing did not pay off
+    bool _gzip;
+    char _etag[11];
+    char _gzipEtag[14];
+    bool _render(fs::FS* fs);
+    void _send(AsyncWebServerRequest *request, fs::FS* fs, const String& contentType);
+
+  public:
+    AsyncWebRenderCache(const String& path, std::function<String(const String&)> processor);
+    AsyncWebRenderCache(const uint8_t* data, size_t len, std::function<String(const String&)> processor);
+    ~AsyncWebRenderCache();
+
+    AsyncWebRenderCache(AsyncWebRenderCache const &) = delete;
+    AsyncWebRenderCache &operator=(AsyncWebRenderCache const &) = delete;
+
+    AsyncWebRenderCache& setGzip(bool gzip); // also keep a compressed copy for clients accepting gzip
+    void invalidate(){ _version.fetch_add(1, std::memory_order_release); }
+    uint32_t version() const { return _version.load(std::memory_order_acquire); }
+    void send(AsyncWebServerRequest *request, fs::FS& fs, const String& contentType=String());
+    void send(AsyncWebServerRequest *request, const String& contentType=String()); // for templates in memory
+};
+
+#endif /* ASYNCWEBTEMPLATE_H_ */
@@ -24,9 +24,15 @@
 #include "Arduino.h"
 
 #include <functional>
+#include <atomic>
 #include "FS.h"
 
 #include "StringArray.h"
+#include "AsyncWebArena.h"
+#include "AsyncWebPool.h"
+#include "AsyncWebSharedBuffer.h"
+#include "AsyncWebTemplate.h"
+#include "AsyncWebResponseCache.h"
 
 #ifdef ESP32
 #include <WiFi.h>
@@ -55,6 +61,8 @@ class AsyncWebRewrite;
 class AsyncWebHandler;
 class AsyncStaticWebHandler;
 class AsyncCallbackWebHandler;
+class AsyncEmbeddedWebHandler;
+struct AsyncWebAssetTable;
 class AsyncResponseStream;
 
 #ifndef WEBSERVER_H
@@ -75,6 +83,7 @@ typedef enum {
 
 typedef uint8_t WebRequestMethodComposite;
 typedef std::function<void(void)> ArDisconnectHandler;
+typedef std::function<bool(void)> ArBodyResumeFunction;
 
 /*
  * PARAMETER :: Chainable object to hold GET/POST and FILE parameters
@@ -128,19 +137,73 @@ class AsyncWebHeader {
 
 typedef enum { RCT_NOT_USED = -1, RCT_DEFAULT = 0, RCT_HTTP, RCT_WS, RCT_EVENT, RCT_MAX } RequestedConnectionType;
 
+// Bytes of request-scoped storage embedded in every request before the arena falls back to the heap
+#ifndef ASYNCWEBSERVER_REQUEST_ARENA_SLAB
+#define ASYNCWEBSERVER_REQUEST_ARENA_SLAB 256
+#endif
+
+// Largest request body accepted, 0 for no limit. Bigger bodies are answered with 413
+#ifndef ASYNCWEBSERVER_MAX_BODY_SIZE
+#define ASYNCWEBSERVER_MAX_BODY_SIZE 0
+#endif
+
+// Path arguments ({name} segments or regex groups) kept per request
+#ifndef ASYNCWEBSERVER_MAX_PATH_ARGS
+#define ASYNCWEBSERVER_MAX_PATH_ARGS 8
+#endif
+
+// Path arguments are kept as offsets into the request url, no copies are made while matching
+struct AsyncWebPathArgs {
+  uint8_t count;
+  uint16_t start[ASYNCWEBSERVER_MAX_PATH_ARGS];
+  uint16_t len[ASYNCWEBSERVER_MAX_PATH_ARGS];
+  AsyncWebPathArgs(): count(0) {}
+  bool add(size_t s, size_t l){
+    if(count == ASYNCWEBSERVER_MAX_PATH_ARGS || s + l > 0xFFFF)
+      return false;
+    start[count] = s;
+    len[count] = l;
+    count++;
+    return true;
+  }
+};
+
 typedef std::function<size_t(uint8_t*, size_t, size_t)> AwsResponseFiller;
 typedef std::function<String(const String&)> AwsTemplateProcessor;
 
+// Handle through which another task wakes a paused request body, see AsyncWebServerRequest::bodyWaker().
+// It outlives the request, the request only drops its own reference when it is deleted
+class AsyncWebBodyWaker {
+  friend class AsyncWebServerRequest;
+  private:
+    AsyncWebServerRequest* _request;    // NULL once the request is gone, only touched on the server task
+    std::atomic<uint8_t> _refs;
+    std::atomic<bool> _pending;         // a wake is queued, further wakes until it ran are dropped
+    AsyncWebBodyWaker(AsyncWebServerRequest* request): _request(request), _refs(1), _pending(false) {}
+    static void _run(void* arg);
+  public:
+    // Any task: re-checks canResume of pauseBody() on the server task right away, resumes if there is none
+    void wake();
+    // Any task: drops the reference handed out by bodyWaker()
+    void release();
+};
+
 class AsyncWebServerRequest {
   using File = fs::File;
   using FS = fs::FS;
   friend class AsyncWebServer;
   friend class AsyncCallbackWebHandler;
+  friend class AsyncWebRouter;
+  friend class AsyncWebBodyWaker;
   private:
     AsyncClient* _client;
     AsyncWebServer* _server;
     AsyncWebHandler* _handler;
     AsyncWebServerResponse* _response;
+#if ASYNCWEBSERVER_REQUEST_ARENA_SLAB > 0
+    alignas(max_align_t) uint8_t _arenaSlab[ASYNCWEBSERVER_REQUEST_ARENA_SLAB];
+#endif
+    AsyncWebArena _arena;
     StringArray _interestingHeaders;
     ArDisconnectHandler _onDisconnectfn;
 
@@ -160,24 +223,48 @@ class AsyncWebServerRequest {
     bool _isMultipart;
     bool _isPlainPost;
     bool _expectingContinue;
+    bool _isChunked;
     size_t _contentLength;
     size_t _parsedLength;
+    uint8_t _chunkState;
+    size_t _chunkRemaining;
 
     LinkedList<AsyncWebHeader *> _headers;
-    LinkedList<AsyncWebParameter *> _params;
-    LinkedList<String *> _pathParams;
+    AsyncWebParameter** _params;        // flat table in the arena, query parameters first
+    uint16_t* _paramHashes;
+    size_t _paramCount;
+    size_t _paramCapacity;
+    size_t _queryParamCount;
+    struct PendingParams {
+      char* text;
+      size_t len;
+      bool form;
+      PendingParams* next;
+    };
+    PendingParams* _pendingParams;      // raw query and form text, decoded on first parameter access
+    PendingParams** _pendingParamsTail;
+    bool _paramsDecoded;
+    LinkedList<String *> _pathParams;   // Strings for pathArg(i), made on first use
+    AsyncWebPathArgs _pathArgs;
 
     uint8_t _multiParseState;
-    uint8_t _boundaryPosition;
+    uint8_t _boundaryPosition;          // bytes of the delimiter matched so far
+    uint8_t _delimiterLength;
+    uint8_t *_delimiter;                // "\r\n--" + boundary
+    uint8_t *_delimiterSkip;            // Boyer-Moore-Horspool shift table for _delimiter
     size_t _itemStartIndex;
     size_t _itemSize;
     String _itemName;
     String _itemFilename;
     String _itemType;
     String _itemValue;
-    uint8_t *_itemBuffer;
-    size_t _itemBufferIndex;
+    uint8_t *_itemBuffer;               // only used for delimiter bytes that turned out to be data
     bool _itemIsFile;
+    bool _bodyPaused;
+    size_t _bodyUnacked;                // received bytes not acked to the sender while paused
+    ArBodyResumeFunction _bodyResume;   // checked on poll, data, ack and wake while paused, resumes once it returns true
+    AsyncWebBodyWaker* _bodyWaker;
+    void _checkBodyResume();
 
     void _onPoll();
     void _onAck(size_t len, uint32_t time);
@@ -186,18 +273,29 @@ class AsyncWebServerRequest {
     void _onDisconnect();
     void _onData(void *buf, size_t len);
 
-    void _addParam(AsyncWebParameter*);
-    void _addPathParam(const char *param);
+    void _addParam(const String& name, const String& value, bool form=false, bool file=false, size_t size=0);
+    bool _insertParam(size_t index, AsyncWebParameter* param);
+    AsyncWebParameter* _findParam(const char* name, size_t len, bool any, bool post, bool file) const;
+    void _addPendingParams(const char* text, size_t len, bool form);
+    void _parseParams(char* text, size_t len, bool form);
+    void _decodeParams() const;
+    void _setPathArgs(const AsyncWebPathArgs& args);
 
     bool _parseReqHead();
     bool _parseReqHeader();
     void _parseLine();
-    void _parsePlainPostChar(uint8_t data);
-    void _parseMultipartPostByte(uint8_t data, bool last);
+    void _parseBody(uint8_t* data, size_t len, bool last);
+    bool _parseChunkedBody(uint8_t* data, size_t len);
+    void _bodyEnd();
+    void _bodyError(int code);
+    void _parsePlainPost(uint8_t* data, size_t len, bool last);
+    void _parseMultipartPost(uint8_t* data, size_t len);
+    void _parseMultipartHeader();
+    void _multipartItemData(uint8_t* data, size_t len);
+    void _multipartItemEnd(uint8_t* data, size_t len);
     void _addGetParams(const String& params);
 
     void _handleUploadStart();
-    void _handleUploadByte(uint8_t data, bool last);
     void _handleUploadEnd();
 
   public:
@@ -207,7 +305,10 @@ class AsyncWebServerRequest {
     AsyncWebServerRequest(AsyncWebServer*, AsyncClient*);
     ~AsyncWebServerRequest();
 
+    static void operator delete(void* ptr); // pooled requests go back to the server pool
+
     AsyncClient* client(){ return _client; }
+    AsyncWebArena& arena(){ return _arena; } // request-scoped storage, released together with the request
     uint8_t version() const { return _version; }
     WebRequestMethodComposite method() const { return _method; }
     const String& url() const { return _url; }
@@ -221,6 +322,16 @@ class AsyncWebServerRequest {
     bool isExpectedRequestedConnType(RequestedConnectionType erct1, RequestedConnectionType erct2 = RCT_NOT_USED, RequestedConnectionType erct3 = RCT_NOT_USED);
     void onDisconnect (ArDisconnectHandler fn);
 
+    // Flow control for slow body and upload consumers: while paused, received data is not acked, so the
+    // TCP receive window closes and the sender stops. Data already in flight (one window) is still delivered.
+    // Both run on the server task only, from the request's own callbacks. To resume once another task caught
+    // up, pass canResume: the server task checks it on every poll, data and ack, and whenever the other task
+    // calls wake() on the bodyWaker(). It must only read state that is safe to share between tasks.
+    void pauseBody(ArBodyResumeFunction canResume = nullptr);
+    void resumeBody();
+    bool bodyPaused() const { return _bodyPaused; }
+    AsyncWebBodyWaker* bodyWaker(); // server task, the caller owns one reference and must release() it
+
     //hash is the string representation of:
     // base64(user:pass) for basic or
     // user:realm:md5(user:realm:pass) for digest
@@ -235,6 +346,8 @@ class AsyncWebServerRequest {
 
     void send(AsyncWebServerResponse *response);
     void send(int code, const String& contentType=String(), const String& content=String());
+    void send(int code, const String& contentType, AsyncWebSharedBuffer* content);
+    void send(int code, const String& contentType, const AsyncWebSharedBody& content);
     void send(FS &fs, const String& path, const String& contentType=String(), bool download=false, AwsTemplateProcessor callback=nullptr);
     void send(File content, const String& path, const String& contentType=String(), bool download=false, AwsTemplateProcessor callback=nullptr);
     void send(Stream &stream, const String& contentType, size_t len, AwsTemplateProcessor callback=nullptr);
@@ -244,6 +357,7 @@ class AsyncWebServerRequest {
     void send_P(int code, const String& contentType, PGM_P content, AwsTemplateProcessor callback=nullptr);
 
     AsyncWebServerResponse *beginResponse(int code, const String& contentType=String(), const String& content=String());
+    AsyncWebServerResponse *beginResponse(int code, const String& contentType, AsyncWebSharedBuffer* content); // the response takes its own reference
     AsyncWebServerResponse *beginResponse(FS &fs, const String& path, const String& contentType=String(), bool download=false, AwsTemplateProcessor callback=nullptr);
     AsyncWebServerResponse *beginResponse(File content, const String& path, const String& contentType=String(), bool download=false, AwsTemplateProcessor callback=nullptr);
     AsyncWebServerResponse *beginResponse(Stream &stream, const String& contentType, size_t len, AwsTemplateProcessor callback=nullptr);
@@ -277,12 +391,17 @@ class AsyncWebServerRequest {
     bool hasArg(const char* name) const;         // check if argument exists
     bool hasArg(const __FlashStringHelper * data) const;         // check if F(argument) exists
 
-    const String& ASYNCWEBSERVER_REGEX_ATTRIBUTE pathArg(size_t i) const;
+    size_t pathArgs() const { return _pathArgs.count; } // get path argument count
+    const String& pathArg(size_t i) const;       // get path argument value by number
+    const char* pathArg(size_t i, size_t* len) const; // same without a copy, points into url() and is NOT null terminated
 
     const String& header(const char* name) const;// get request header value by name
     const String& header(const __FlashStringHelper * data) const;// get request header value by F(name)    
     const String& header(size_t i) const;        // get request header value by number
     const String& headerName(size_t i) const;    // get request header name by number
+    uint16_t acceptsEncoding(const char* coding) const; // q-value of coding under Accept-Encoding, in thousandths
+    bool acceptsGzip() const;                    // check if a gzip body is acceptable (Accept-Encoding)
+    bool etagMatches(const char* etag) const;    // If-None-Match is * or lists etag, weak tags compare equal to strong ones
     String urlDecode(const String& text) const;
 };
 
@@ -345,6 +464,70 @@ class AsyncWebHandler {
     virtual void handleUpload(AsyncWebServerRequest *request  __attribute__((unused)), const String& filename __attribute__((unused)), size_t index __attribute__((unused)), uint8_t *data __attribute__((unused)), size_t len __attribute__((unused)), bool final  __attribute__((unused))){}
     virtual void handleBody(AsyncWebServerRequest *request __attribute__((unused)), uint8_t *data __attribute__((unused)), size_t len __attribute__((unused)), size_t index __attribute__((unused)), size_t total __attribute__((unused))){}
     virtual bool isRequestHandlerTrivial(){return true;}
+
+    // Handlers selected purely by method and uri describe themselves here so the server can index
+    // them in its route table. Once the table matched, _routeMatched() is called instead of canHandle().
+    virtual bool _getRoute(const String** uri __attribute__((unused)), WebRequestMethodComposite* method __attribute__((unused))){ return false; }
+    virtual bool _routeMatched(AsyncWebServerRequest *request){ return canHandle(request); }
+};
+
+/*
+ * ROUTER :: Handlers compiled into a trie keyed by path segment (done by the Server)
+ * */
+
+class AsyncWebRouter {
+  private:
+    struct Route {
+      AsyncWebHandler* handler;
+      uint16_t order;
+      WebRequestMethodComposite method;
+      const char* partial;
+      size_t partialLen;
+      Route* next;
+    };
+    struct Node {
+      const char* label;
+      size_t len;
+      WebRequestMethodComposite methods; // every method routed at or below this node
+      Node* children;
+      Node* sibling;
+      Node* param;                        // {name} segment, matches any non-empty segment
+      Route* routes;                      // uri ends here: matches the path and everything below it
+      Route* wildcards;                   // "prefix*": next segment has to start with partial
+    };
+    AsyncWebArena _arena;
+    Node* _root;
+    Route* _any;
+    Route* _extensions;
+    Route* _fallback;
+    uint32_t _builtGeneration;
+    static uint32_t _generation;
+
+    Node* _newNode(const char* label, size_t len);
+    Node* _child(Node* node, const char* label, size_t len);
+    Route* _newRoute(AsyncWebHandler* handler, uint16_t order, WebRequestMethodComposite method, const char* partial, size_t partialLen);
+    static void _append(Route** list, Route* route);
+    struct Match {
+      const char* url;
+      WebRequestMethodComposite method;
+      uint16_t minOrder;
+      AsyncWebPathArgs args;              // {name} segments on the way to the current node
+      const Route* best;
+      AsyncWebPathArgs bestArgs;
+    };
+    static void _consider(const Route* route, Match* m);
+    bool _insert(AsyncWebHandler* handler, uint16_t order);
+    void _walk(const Node* node, const char* p, const char* end, bool more, Match* m) const;
+    void _match(const char* url, size_t len, Match* m) const;
+
+  public:
+    AsyncWebRouter();
+    static void changed(){ _generation++; } // any handler set or route change triggers a rebuild
+    bool dirty() const { return _builtGeneration != _generation; }
+    void build(const LinkedList<AsyncWebHandler*>& handlers);
+    AsyncWebHandler* find(AsyncWebServerRequest *request) const;
+    // canHandle() equivalent of the table lookup for a single uri with {name} segments
+    static bool matchTemplate(const String& uri, const String& url, AsyncWebPathArgs* args);
 };
 
 /*
@@ -363,12 +546,17 @@ class AsyncWebServerResponse {
     size_t _contentLength;
     bool _sendContentLength;
     bool _chunked;
+    bool _closeConnection;
+    bool _acceptRanges; // advertised as "Accept-Ranges: bytes"
+    bool _gzip;         // compress the content for clients that accept it
     size_t _headLength;
     size_t _sentLength;
     size_t _ackedLength;
     size_t _writtenLength;
     WebResponseState _state;
     const char* _responseCodeToString(int code);
+    size_t _writeHead(uint8_t version, char* out);
+    bool _gzipFor(AsyncWebServerRequest *request);
 
   public:
     AsyncWebServerResponse();
@@ -377,7 +565,11 @@ class AsyncWebServerResponse {
     virtual void setContentLength(size_t len);
     virtual void setContentType(const String& type);
     virtual void addHeader(const String& name, const String& value);
+    void setAcceptRanges(bool accept){ _acceptRanges = accept; } // whoever serves ranges of this content
+    void setGzip(bool gzip){ _gzip = gzip; } // text generated per request, content of at least ASYNCWEBSERVER_GZIP_THRESHOLD bytes
     virtual String _assembleHead(uint8_t version);
+    size_t _headSize(uint8_t version){ return _writeHead(version, NULL); }
+    size_t _sendHead(AsyncWebServerRequest *request);
     virtual bool _started() const;
     virtual bool _finished() const;
     virtual bool _failed() const;
@@ -390,6 +582,21 @@ class AsyncWebServerResponse {
  * SERVER :: One instance
  * */
 
+// Transmit buffers reserved by begin() and shared by all servers, 0 sends from malloc'd copies instead.
+// A buffer is only held while a response fills and writes it, so a few serve every connection
+#ifndef ASYNCWEBSERVER_TX_BUFFERS
+#define ASYNCWEBSERVER_TX_BUFFERS 2
+#endif
+
+// Size of one transmit buffer, one write of it fills the default lwIP send window
+#ifndef ASYNCWEBSERVER_TX_BUFFER_SIZE
+#ifdef TCP_MSS
+#define ASYNCWEBSERVER_TX_BUFFER_SIZE (4 * TCP_MSS)
+#else
+#define ASYNCWEBSERVER_TX_BUFFER_SIZE (4 * 1436)
+#endif
+#endif
+
 typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
 typedef std::function<void(AsyncWebServerRequest *request, const String& filename, size_t index, uint8_t *data, size_t len, bool final)> ArUploadHandlerFunction;
 typedef std::function<void(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)> ArBodyHandlerFunction;
@@ -400,12 +607,21 @@ class AsyncWebServer {
     LinkedList<AsyncWebRewrite*> _rewrites;
     LinkedList<AsyncWebHandler*> _handlers;
     AsyncCallbackWebHandler* _catchAllHandler;
+    AsyncWebPool* _requestPool;
+    AsyncWebRouter _router;
+    static AsyncWebPool* _txPool;
+    static size_t _txMisses;
 
   public:
     AsyncWebServer(uint16_t port);
     ~AsyncWebServer();
 
-    void begin();
+    static size_t txBuffersFree(){ return _txPool ? _txPool->available() : 0; }
+    static size_t txBufferMisses(){ return _txMisses; } // times a response found no free transmit buffer and used the heap
+    static AsyncWebPool* _txBuffers(){ return _txPool; }
+    static void _txBufferMiss(){ _txMisses++; }
+
+    void begin(size_t maxConnections = 0); // > 0 preallocates clients and requests, connections above the limit are refused
     void end();
 
 #if ASYNC_TCP_SSL_ENABLED
@@ -426,6 +642,7 @@ class AsyncWebServer {
     AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody);
 
     AsyncStaticWebHandler& serveStatic(const char* uri, fs::FS& fs, const char* path, const char* cache_control = NULL);
+    AsyncEmbeddedWebHandler& serveEmbedded(const char* uri, const AsyncWebAssetTable& assets, const char* cache_control = NULL);
 
     void onNotFound(ArRequestHandlerFunction fn);  //called when handler is not assigned
     void onFileUpload(ArUploadHandlerFunction fn); //handle file uploads
@@ -441,16 +658,22 @@ class AsyncWebServer {
 class DefaultHeaders {
   using headers_t = LinkedList<AsyncWebHeader *>;
   headers_t _headers;
+  String _block;
   
   DefaultHeaders()
   :_headers(headers_t([](AsyncWebHeader *h){ delete h; }))
+  , _block()
   {}
 public:
   using ConstIterator = headers_t::ConstIterator;
 
   void addHeader(const String& name, const String& value){
     _headers.add(new AsyncWebHeader(name, value));
+    // kept serialized as well, every response head copies it in one go
+    _block += name + ": " + value + "\r\n";
   }  
+
+  const String& block() const { return _block; }
   
   ConstIterator begin() const { return _headers.begin(); }
   ConstIterator end() const { return _headers.end(); }
@@ -497,6 +497,8 @@ void SPIFFSEditor::handleRequest(AsyncWebServerRequest *request){
   } else if(request->method() == HTTP_DELETE){
     if(request->hasParam("path", true)){
         _fs.remove(request->getParam("path", true)->value());
+        AsyncStaticWebHandler::invalidateAll();
+        AsyncWebTemplate::flush();
       request->send(200, "", "DELETE: "+request->getParam("path", true)->value());
     } else
       request->send(404);
@@ -515,6 +517,8 @@ void SPIFFSEditor::handleRequest(AsyncWebServerRequest *request){
         if(f){
           f.write((uint8_t)0x00);
           f.close();
+          AsyncStaticWebHandler::invalidateAll();
+          AsyncWebTemplate::flush();
           request->send(200, "", "CREATE: "+filename);
         } else {
           request->send(500);
@@ -539,6 +543,8 @@ void SPIFFSEditor::handleUpload(AsyncWebServerRequest *request, const String& fi
     }
     if(final){
       request->_tempFile.close();
+      AsyncStaticWebHandler::invalidateAll();
+      AsyncWebTemplate::flush();
     }
   }
 }
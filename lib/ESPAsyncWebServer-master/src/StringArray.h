@@ -23,6 +23,7 @@
 
 #include "stddef.h"
 #include "WString.h"
+#include "AsyncWebArena.h"
 
 template <typename T>
 class LinkedListNode {
@@ -44,6 +45,19 @@ class LinkedList {
   private:
     ItemType* _root;
     OnRemove _onRemove;
+    AsyncWebArena* _arena;
+
+    ItemType* _newItem(const T& t){
+      if(_arena)
+        return _arena->create<ItemType>(t);
+      return new ItemType(t);
+    }
+    void _deleteItem(ItemType* it){
+      if(_arena)
+        AsyncWebArena::destroy(it);
+      else
+        delete it;
+    }
 
     class Iterator {
       ItemType* _node;
@@ -61,10 +75,12 @@ class LinkedList {
     ConstIterator begin() const { return ConstIterator(_root); }
     ConstIterator end() const { return ConstIterator(nullptr); }
 
-    LinkedList(OnRemove onRemove) : _root(nullptr), _onRemove(onRemove) {}
+    LinkedList(OnRemove onRemove, AsyncWebArena* arena = nullptr) : _root(nullptr), _onRemove(onRemove), _arena(arena) {}
     ~LinkedList(){}
     void add(const T& t){
-      auto it = new ItemType(t);
+      auto it = _newItem(t);
+      if(!it)
+        return;
       if(!_root){
         _root = it;
       } else {
@@ -128,7 +144,7 @@ class LinkedList {
             _onRemove(it->value());
           }
           
-          delete it;
+          _deleteItem(it);
           return true;
         }
         pit = it;
@@ -149,7 +165,7 @@ class LinkedList {
           if (_onRemove) {
             _onRemove(it->value());
           }
-          delete it;
+          _deleteItem(it);
           return true;
         }
         pit = it;
@@ -165,7 +181,7 @@ class LinkedList {
         if (_onRemove) {
           _onRemove(it->value());
         }
-        delete it;
+        _deleteItem(it);
       }
       _root = nullptr;
     }
@@ -175,7 +191,7 @@ class LinkedList {
 class StringArray : public LinkedList<String> {
 public:
   
-  StringArray() : LinkedList(nullptr) {}
+  StringArray(AsyncWebArena* arena = nullptr) : LinkedList(nullptr, arena) {}
   
   bool containsIgnoreCase(const String& str){
     for (const auto& s : *this) {
@@ -29,13 +29,75 @@
 #include "stddef.h"
 #include <time.h>
 
+// Request paths whose resolved file each static handler remembers, 0 opens the files on every request
+#ifndef ASYNCWEBSERVER_STATIC_META_CACHE
+#define ASYNCWEBSERVER_STATIC_META_CACHE 16
+#endif
+
+// What a request path resolved to, handed from canHandle() to handleRequest() in the request arena
+struct AsyncStaticFileInfo {
+  const char* key;  // request path below the handler uri
+  const char* path; // the name responses are sent under
+  const char* file; // the file to open, path or path.gz
+  size_t size;
+  time_t mtime;
+  const char* etag; // empty when the handler sends none
+  bool immutable;   // listed in the asset manifest
+  bool vary;        // encoded variants exist, the choice depends on Accept-Encoding
+};
+
+struct AsyncStaticCacheStats {
+  size_t hits;      // responses sent from RAM
+  size_t misses;    // cacheable files that had to be read from the file system
+  size_t evictions; // files dropped to stay within the budget
+  size_t bytes;     // content held right now
+};
+
 class AsyncStaticWebHandler: public AsyncWebHandler {
    using File = fs::File;
    using FS = fs::FS;
   private:
+    struct MetaEntry {
+      String key;  // request path below _uri and the encodings accepted
+      String path;
+      String file;
+      size_t size;
+      time_t mtime;
+      String etag;
+      bool immutable;
+      bool vary;
+      bool found;  // misses are remembered as well
+      uint32_t used;
+      AsyncWebSharedBuffer* content; // file content while it is in the RAM cache
+    };
+    MetaEntry* _meta;
+    // Content hashes by file, shared by every key that resolves to it. A file is only hashed again once
+    // its size or mtime changed, invalidate() drops the ones without an mtime since that can not tell
+    struct ETagEntry {
+      String file;
+      size_t size;
+      time_t mtime;
+      String etag;
+      uint32_t used;
+    };
+    ETagEntry* _etags;
+    uint32_t _metaTick;
+    uint32_t _metaGeneration;
+    static uint32_t _generation;
+    size_t _ramBudget;
+    size_t _ramMaxFile;
+    AsyncStaticCacheStats _ramStats;
+    void _dropContent(MetaEntry* entry);
+    void _fitRamBudget(const MetaEntry* keep);
+    AsyncWebServerResponse* _cachedResponse(AsyncWebSharedBuffer* content, AsyncStaticFileInfo* info);
+    void _addCacheHeaders(AsyncWebServerResponse* response, AsyncStaticFileInfo* info);
+    String _makeETag(const String& name, File& file, bool immutable);
+    bool _isImmutable(const String& path);
+    MetaEntry* _findMeta(const String& key);
+    MetaEntry* _newMeta();
+    bool _resolve(AsyncWebServerRequest *request, const String& key, const uint16_t* accepted, MetaEntry* entry);
     bool _getFile(AsyncWebServerRequest *request);
-    bool _fileExists(AsyncWebServerRequest *request, const String& path);
-    uint8_t _countBits(const uint8_t value) const;
+    bool _fileExists(AsyncWebServerRequest *request, const String& path, const uint16_t* accepted, MetaEntry* entry);
   protected:
     FS _fs;
     String _uri;
@@ -43,12 +105,14 @@ class AsyncStaticWebHandler: public AsyncWebHandler {
     String _default_file;
     String _cache_control;
     String _last_modified;
+    String _manifestPath;
+    String _manifest; // "\n" + manifest content once loaded
+    String _immutable_cache_control;
     AwsTemplateProcessor _callback;
     bool _isDir;
-    bool _gzipFirst;
-    uint8_t _gzipStats;
   public:
     AsyncStaticWebHandler(const char* uri, FS& fs, const char* path, const char* cache_control);
+    ~AsyncStaticWebHandler();
     virtual bool canHandle(AsyncWebServerRequest *request) override final;
     virtual void handleRequest(AsyncWebServerRequest *request) override final;
     AsyncStaticWebHandler& setIsDir(bool isDir);
@@ -61,6 +125,51 @@ class AsyncStaticWebHandler: public AsyncWebHandler {
     AsyncStaticWebHandler& setLastModified(); //sets to current time. Make sure sntp is runing and time is updated
   #endif
     AsyncStaticWebHandler& setTemplateProcessor(AwsTemplateProcessor newCallback) {_callback = newCallback; return *this;}
+    // Keep files up to maxFileSize (at most budget) bytes in RAM, least recently used dropped first beyond budget bytes. 0 turns it off
+    AsyncStaticWebHandler& setRamCache(size_t budget, size_t maxFileSize=8192);
+    const AsyncStaticCacheStats& ramCacheStats() const { return _ramStats; }
+    // Files listed in the manifest (one path per line, tab and anything after ignored) never change under
+    // their name, they are sent with cache_control instead of the handler's own
+    AsyncStaticWebHandler& setImmutable(const char* manifest, const char* cache_control="public, max-age=31536000, immutable");
+    void invalidate(); // forget resolved files, call after the files below path changed
+    static void invalidateAll(){ _generation++; } // the same for every static handler
+};
+
+// One file compiled into the firmware, see scripts/build_web.py
+struct AsyncWebAsset {
+  const char* path;        // as requested, without .gz
+  const uint8_t* data;     // PROGMEM
+  uint32_t length;
+  const char* contentType;
+  const char* etag;
+  bool gzip;               // data is gzip encoded
+  bool immutable;          // the name carries a content hash
+};
+
+// Assets by path through a perfect hash, slot fnv1a(seed, path) % size holds the only candidate (or -1)
+struct AsyncWebAssetTable {
+  const AsyncWebAsset* assets;
+  const int16_t* slots;
+  uint16_t size;
+  uint32_t seed;
+  const AsyncWebAsset* find(const char* path, size_t len) const;
+  const AsyncWebAsset* find(const char* path) const { return find(path, strlen(path)); }
+};
+
+class AsyncEmbeddedWebHandler: public AsyncWebHandler {
+  private:
+    const AsyncWebAsset* _find(AsyncWebServerRequest *request) const;
+  protected:
+    String _uri;
+    const AsyncWebAssetTable& _assets;
+    String _default_file;
+    String _cache_control; // for assets without a hashed name
+  public:
+    AsyncEmbeddedWebHandler(const char* uri, const AsyncWebAssetTable& assets, const char* cache_control);
+    virtual bool canHandle(AsyncWebServerRequest *request) override final;
+    virtual void handleRequest(AsyncWebServerRequest *request) override final;
+    AsyncEmbeddedWebHandler& setDefaultFile(const char* filename);
+    AsyncEmbeddedWebHandler& setCacheControl(const char* cache_control);
 };
 
 class AsyncCallbackWebHandler: public AsyncWebHandler {
@@ -72,13 +181,24 @@ class AsyncCallbackWebHandler: public AsyncWebHandler {
     ArUploadHandlerFunction _onUpload;
     ArBodyHandlerFunction _onBody;
     bool _isRegex;
+    bool _isTemplate;
+#ifdef ASYNCWEBSERVER_REGEX
+    std::regex _pattern;  // compiled once in setUri()
+    std::cmatch _matches; // kept around so matching does not allocate once it has grown
+#endif
   public:
-    AsyncCallbackWebHandler() : _uri(), _method(HTTP_ANY), _onRequest(NULL), _onUpload(NULL), _onBody(NULL), _isRegex(false) {}
+    AsyncCallbackWebHandler() : _uri(), _method(HTTP_ANY), _onRequest(NULL), _onUpload(NULL), _onBody(NULL), _isRegex(false), _isTemplate(false) {}
     void setUri(const String& uri){ 
       _uri = uri; 
       _isRegex = uri.startsWith("^") && uri.endsWith("$");
+      _isTemplate = !_isRegex && uri.indexOf('{') >= 0;
+#ifdef ASYNCWEBSERVER_REGEX
+      if(_isRegex)
+        _pattern.assign(uri.c_str());
+#endif
+      AsyncWebRouter::changed();
     }
-    void setMethod(WebRequestMethodComposite method){ _method = method; }
+    void setMethod(WebRequestMethodComposite method){ _method = method; AsyncWebRouter::changed(); }
     void onRequest(ArRequestHandlerFunction fn){ _onRequest = fn; }
     void onUpload(ArUploadHandlerFunction fn){ _onUpload = fn; }
     void onBody(ArBodyHandlerFunction fn){ _onBody = fn; }
@@ -91,17 +211,14 @@ class AsyncCallbackWebHandler: public AsyncWebHandler {
       if(!(_method & request->method()))
         return false;
 
+      AsyncWebPathArgs args;
 #ifdef ASYNCWEBSERVER_REGEX
       if (_isRegex) {
-        std::regex pattern(_uri.c_str());
-        std::smatch matches;
-        std::string s(request->url().c_str());
-        if(std::regex_search(s, matches, pattern)) {
-          for (size_t i = 1; i < matches.size(); ++i) { // start from 1
-            request->_addPathParam(matches[i].str().c_str());
-          }
-        } else {
+        const String& url = request->url();
+        if(!std::regex_search(url.c_str(), url.c_str() + url.length(), _matches, _pattern))
           return false;
+        for (size_t i = 1; i < _matches.size(); ++i) { // start from 1
+          args.add(_matches.position(i), _matches.length(i));
         }
       } else 
 #endif
@@ -112,6 +229,11 @@ class AsyncCallbackWebHandler: public AsyncWebHandler {
            return false;
       }
       else
+      if (_isTemplate) {
+        if (!AsyncWebRouter::matchTemplate(_uri, request->url(), &args))
+          return false;
+      }
+      else
       if (_uri.length() && _uri.endsWith("*")) {
         String uriTemplate = String(_uri);
 	uriTemplate = uriTemplate.substring(0, uriTemplate.length() - 1);
@@ -121,6 +243,23 @@ class AsyncCallbackWebHandler: public AsyncWebHandler {
       else if(_uri.length() && (_uri != request->url() && !request->url().startsWith(_uri+"/")))
         return false;
 
+      request->_setPathArgs(args);
+      request->addInterestingHeader("ANY");
+      return true;
+    }
+
+    virtual bool _getRoute(const String** uri, WebRequestMethodComposite* method) override final {
+      if(_isRegex)
+        return false;
+      *uri = &_uri;
+      *method = _method;
+      return true;
+    }
+
+    virtual bool _routeMatched(AsyncWebServerRequest *request) override final {
+      // method and uri were already matched by the route table
+      if(!_onRequest)
+        return false;
       request->addInterestingHeader("ANY");
       return true;
     }
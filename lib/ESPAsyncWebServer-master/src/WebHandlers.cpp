@@ -21,8 +21,11 @@
 #include "ESPAsyncWebServer.h"
 #include "WebHandlerImpl.h"
 
+uint32_t AsyncStaticWebHandler::_generation = 0;
+
 AsyncStaticWebHandler::AsyncStaticWebHandler(const char* uri, FS& fs, const char* path, const char* cache_control)
-  : _fs(fs), _uri(uri), _path(path), _default_file("index.htm"), _cache_control(cache_control), _last_modified(""), _callback(nullptr)
+  : _meta(NULL), _etags(NULL), _metaTick(0), _metaGeneration(_generation), _ramBudget(0), _ramMaxFile(0), _ramStats()
+  , _fs(fs), _uri(uri), _path(path), _default_file("index.htm"), _cache_control(cache_control), _last_modified(""), _callback(nullptr)
 {
   // Ensure leading '/'
   if (_uri.length() == 0 || _uri[0] != '/') _uri = "/" + _uri;
@@ -36,19 +39,22 @@ AsyncStaticWebHandler::AsyncStaticWebHandler(const char* uri, FS& fs, const char
   // Notice that root will be "" not "/"
   if (_uri[_uri.length()-1] == '/') _uri = _uri.substring(0, _uri.length()-1);
   if (_path[_path.length()-1] == '/') _path = _path.substring(0, _path.length()-1);
+}
 
-  // Reset stats
-  _gzipFirst = false;
-  _gzipStats = 0xF8;
+AsyncStaticWebHandler::~AsyncStaticWebHandler(){
+  invalidate();
+  delete[] _etags;
 }
 
 AsyncStaticWebHandler& AsyncStaticWebHandler::setIsDir(bool isDir){
   _isDir = isDir;
+  invalidate();
   return *this;
 }
 
 AsyncStaticWebHandler& AsyncStaticWebHandler::setDefaultFile(const char* filename){
   _default_file = String(filename);
+  invalidate();
   return *this;
 }
 
@@ -92,8 +98,8 @@ bool AsyncStaticWebHandler::canHandle(AsyncWebServerRequest *request){
     if (_last_modified.length())
       request->addInterestingHeader("If-Modified-Since");
 
-    if(_cache_control.length())
-      request->addInterestingHeader("If-None-Match");
+    // every file gets an ETag, browsers revalidate with it even without Cache-Control
+    request->addInterestingHeader("If-None-Match");
 
     DEBUGF("[AsyncStaticWebHandler::canHandle] TRUE\n");
     return true;
@@ -102,18 +108,166 @@ bool AsyncStaticWebHandler::canHandle(AsyncWebServerRequest *request){
   return false;
 }
 
+AsyncStaticWebHandler& AsyncStaticWebHandler::setImmutable(const char* manifest, const char* cache_control){
+  _manifestPath = String(manifest);
+  _immutable_cache_control = String(cache_control);
+  invalidate();
+  return *this;
+}
+
+AsyncStaticWebHandler& AsyncStaticWebHandler::setRamCache(size_t budget, size_t maxFileSize){
+  _ramBudget = budget;
+  // a file bigger than the whole budget could only be kept by going over it
+  _ramMaxFile = (maxFileSize < budget) ? maxFileSize : budget;
+  _fitRamBudget(NULL);
+  return *this;
+}
+
+void AsyncStaticWebHandler::invalidate(){
+  if(_meta){
+    for(size_t i = 0; i < ASYNCWEBSERVER_STATIC_META_CACHE; i++)
+      _dropContent(&_meta[i]);
+  }
+  delete[] _meta;
+  _meta = NULL;
+  if(_etags){
+    for(size_t i = 0; i < ASYNCWEBSERVER_STATIC_META_CACHE; i++){
+      if(_etags[i].mtime == 0)
+        _etags[i].used = 0;
+    }
+  }
+  _metaGeneration = _generation;
+  _manifest = String(); // a new upload may bring a new manifest
+}
+
+void AsyncStaticWebHandler::_dropContent(MetaEntry* entry){
+  if(entry->content == NULL)
+    return;
+  _ramStats.bytes -= entry->content->length();
+  entry->content->release();
+  entry->content = NULL;
+}
+
+// Drops the least recently used content until the cache is within budget
+void AsyncStaticWebHandler::_fitRamBudget(const MetaEntry* keep){
+  while(_meta && _ramStats.bytes > _ramBudget){
+    MetaEntry* oldest = NULL;
+    for(size_t i = 0; i < ASYNCWEBSERVER_STATIC_META_CACHE; i++){
+      if(_meta[i].content && &_meta[i] != keep && (oldest == NULL || _meta[i].used < oldest->used))
+        oldest = &_meta[i];
+    }
+    if(oldest == NULL)
+      return;
+    _dropContent(oldest);
+    _ramStats.evictions++;
+  }
+}
+
+AsyncStaticWebHandler::MetaEntry* AsyncStaticWebHandler::_findMeta(const String& key){
+  if(_metaGeneration != _generation)
+    invalidate();
+  if(_meta == NULL)
+    return NULL;
+  for(size_t i = 0; i < ASYNCWEBSERVER_STATIC_META_CACHE; i++){
+    if(_meta[i].used && _meta[i].key == key){
+      _meta[i].used = ++_metaTick;
+      return &_meta[i];
+    }
+  }
+  return NULL;
+}
+
+// A free slot, or the least recently used one
+AsyncStaticWebHandler::MetaEntry* AsyncStaticWebHandler::_newMeta(){
+  if(_meta == NULL){
+    _meta = new MetaEntry[ASYNCWEBSERVER_STATIC_META_CACHE];
+    for(size_t i = 0; i < ASYNCWEBSERVER_STATIC_META_CACHE; i++){
+      _meta[i].used = 0;
+      _meta[i].content = NULL;
+    }
+  }
+  MetaEntry* slot = &_meta[0];
+  for(size_t i = 1; i < ASYNCWEBSERVER_STATIC_META_CACHE && slot->used; i++){
+    if(_meta[i].used < slot->used)
+      slot = &_meta[i];
+  }
+  _dropContent(slot);
+  slot->used = ++_metaTick;
+  return slot;
+}
+
+// Variants a file may be stored in, preferred in this order when the client accepts them equally
+static const struct {
+  const char* ext;
+  const char* coding;
+} FILE_ENCODINGS[] = {{".br", "br"}, {".gz", "gzip"}, {"", NULL}};
+#define FILE_ENCODING_COUNT (sizeof(FILE_ENCODINGS) / sizeof(FILE_ENCODINGS[0]))
+
+// q-values (in thousandths) of each FILE_ENCODINGS entry under the request's Accept-Encoding (RFC 7231, 5.3.4)
+static void acceptedEncodings(AsyncWebServerRequest *request, uint16_t* accepted)
+{
+  if (!request->hasHeader("Accept-Encoding")) {
+    // any coding is acceptable, the plain file is preferred
+    for (size_t i = 0; i < FILE_ENCODING_COUNT; i++)
+      accepted[i] = FILE_ENCODINGS[i].coding ? 1 : 1000;
+    return;
+  }
+  for (size_t i = 0; i < FILE_ENCODING_COUNT; i++)
+    accepted[i] = request->acceptsEncoding(FILE_ENCODINGS[i].coding ? FILE_ENCODINGS[i].coding : "identity");
+}
+
 bool AsyncStaticWebHandler::_getFile(AsyncWebServerRequest *request)
 {
   // Remove the found uri
   String path = request->url().substring(_uri.length());
 
+  // clients accepting the same encodings resolve to the same variant
+  uint16_t accepted[FILE_ENCODING_COUNT];
+  acceptedEncodings(request, accepted);
+  String key = path;
+  for (size_t i = 0; i < FILE_ENCODING_COUNT; i++) {
+    key += i ? ',' : '\n';
+    key += String((unsigned)accepted[i]);
+  }
+
+  MetaEntry* entry = ASYNCWEBSERVER_STATIC_META_CACHE ? _findMeta(key) : NULL;
+  MetaEntry resolved;
+  resolved.content = NULL;
+  if(entry == NULL){
+    entry = ASYNCWEBSERVER_STATIC_META_CACHE ? _newMeta() : &resolved;
+    entry->key = key;
+    entry->found = _resolve(request, path, accepted, entry);
+  }
+  if(!entry->found)
+    return false;
+
+  AsyncStaticFileInfo* info = request->arena().create<AsyncStaticFileInfo>();
+  if(info == NULL)
+    return false;
+  info->key = request->arena().strdup(key.c_str(), key.length());
+  info->path = request->arena().strdup(entry->path.c_str(), entry->path.length());
+  info->file = request->arena().strdup(entry->file.c_str(), entry->file.length());
+  info->size = entry->size;
+  info->mtime = entry->mtime;
+  info->etag = request->arena().strdup(entry->etag.c_str(), entry->etag.length());
+  info->immutable = entry->immutable;
+  info->vary = entry->vary;
+  request->_tempObject = (void*)info;
+  return true;
+}
+
+// The file system lookup behind a cache miss, request->_tempFile is left open when found
+bool AsyncStaticWebHandler::_resolve(AsyncWebServerRequest *request, const String& key, const uint16_t* accepted, MetaEntry* entry)
+{
+  String path = key;
+
   // We can skip the file check and look for default if request is to the root of a directory or that request path ends with '/'
   bool canSkipFileCheck = (_isDir && path.length() == 0) || (path.length() && path[path.length()-1] == '/');
 
   path = _path + path;
 
   // Do we have a file or .gz file
-  if (!canSkipFileCheck && _fileExists(request, path))
+  if (!canSkipFileCheck && _fileExists(request, path, accepted, entry))
     return true;
 
   // Can't handle if not default file
@@ -125,7 +279,7 @@ bool AsyncStaticWebHandler::_getFile(AsyncWebServerRequest *request)
     path += "/";
   path += _default_file;
 
-  return _fileExists(request, path);
+  return _fileExists(request, path, accepted, entry);
 }
 
 #ifdef ESP32
@@ -134,87 +288,324 @@ bool AsyncStaticWebHandler::_getFile(AsyncWebServerRequest *request)
 #define FILE_IS_REAL(f) (f == true)
 #endif
 
-bool AsyncStaticWebHandler::_fileExists(AsyncWebServerRequest *request, const String& path)
+/*
+ * Every stored variant of path is looked at, the one with the highest q-value
+ * wins and the smallest of equally acceptable ones. A variant the client did
+ * not accept is still sent when it is the only one, as before negotiation.
+ * */
+bool AsyncStaticWebHandler::_fileExists(AsyncWebServerRequest *request, const String& path, const uint16_t* accepted, MetaEntry* entry)
 {
-  bool fileFound = false;
-  bool gzipFound = false;
-
-  String gzip = path + ".gz";
-
-  if (_gzipFirst) {
-    request->_tempFile = _fs.open(gzip, "r");
-    gzipFound = FILE_IS_REAL(request->_tempFile);
-    if (!gzipFound){
-      request->_tempFile = _fs.open(path, "r");
-      fileFound = FILE_IS_REAL(request->_tempFile);
-    }
-  } else {
-    request->_tempFile = _fs.open(path, "r");
-    fileFound = FILE_IS_REAL(request->_tempFile);
-    if (!fileFound){
-      request->_tempFile = _fs.open(gzip, "r");
-      gzipFound = FILE_IS_REAL(request->_tempFile);
+  int best = -1;
+  bool encoded = false;
+
+  for (size_t i = 0; i < FILE_ENCODING_COUNT; i++) {
+    File file = _fs.open(path + FILE_ENCODINGS[i].ext, "r");
+    if (!FILE_IS_REAL(file))
+      continue;
+    if (FILE_ENCODINGS[i].coding)
+      encoded = true;
+    if (best < 0 || accepted[i] > accepted[best]
+      || (accepted[i] == accepted[best] && file.size() < request->_tempFile.size())) {
+      request->_tempFile = file;
+      best = i;
     }
   }
 
-  bool found = fileFound || gzipFound;
+  if (best < 0) {
+    request->_tempFile = File();
+    return false;
+  }
 
-  if (found) {
-    // Extract the file name from the path and keep it in _tempObject
-    size_t pathLen = path.length();
-    char * _tempPath = (char*)malloc(pathLen+1);
-    snprintf(_tempPath, pathLen+1, "%s", path.c_str());
-    request->_tempObject = (void*)_tempPath;
+  entry->path = path;
+  entry->file = path + FILE_ENCODINGS[best].ext;
+  entry->size = request->_tempFile.size();
+  entry->mtime = request->_tempFile.getLastWrite();
+  entry->immutable = _isImmutable(path);
+  entry->etag = _makeETag(entry->file, request->_tempFile, entry->immutable);
+  entry->vary = encoded;
+  return true;
+}
 
-    // Calculate gzip statistic
-    _gzipStats = (_gzipStats << 1) + (gzipFound ? 1 : 0);
-    if (_gzipStats == 0x00) _gzipFirst = false; // All files are not gzip
-    else if (_gzipStats == 0xFF) _gzipFirst = true; // All files are gzip
-    else _gzipFirst = _countBits(_gzipStats) > 4; // IF we have more gzip files - try gzip first
+static uint64_t fnv1a(uint64_t hash, const uint8_t* data, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    hash = (hash ^ data[i]) * 1099511628211ULL;
+  return hash;
+}
+
+/*
+ * Strong ETag from the file content (FNV-1a 64), computed while resolving and kept per file, so
+ * other keys resolving to it do not read it again. Files in the manifest carry a content hash in
+ * their name, theirs is a hash of the name. Without a metadata cache hashing would read every
+ * file twice per request, those get a weak tag from size and mtime instead. Templated output
+ * differs from the file, no tag.
+ * */
+String AsyncStaticWebHandler::_makeETag(const String& name, File& file, bool immutable)
+{
+  char tag[24];
+  if (_callback)
+    return String();
+  if (!ASYNCWEBSERVER_STATIC_META_CACHE) {
+    snprintf(tag, sizeof(tag), "W/\"%x-%lx\"", (unsigned)file.size(), (unsigned long)file.getLastWrite());
+    return String(tag);
+  }
+  uint64_t hash = 14695981039346656037ULL;
+  if (immutable) {
+    hash = fnv1a(hash, (const uint8_t*)name.c_str(), name.length());
+    snprintf(tag, sizeof(tag), "\"%08x%08x\"", (unsigned)(hash >> 32), (unsigned)hash);
+    return String(tag);
+  }
+
+  const size_t size = file.size();
+  const time_t mtime = file.getLastWrite();
+  if (_etags == NULL) {
+    _etags = new ETagEntry[ASYNCWEBSERVER_STATIC_META_CACHE];
+    for (size_t i = 0; i < ASYNCWEBSERVER_STATIC_META_CACHE; i++)
+      _etags[i].used = 0;
+  }
+  // the entry of this file if there is one, else a free or the least recently used one
+  ETagEntry* slot = &_etags[0];
+  for (size_t i = 0; i < ASYNCWEBSERVER_STATIC_META_CACHE; i++) {
+    if (_etags[i].used && _etags[i].file == name) {
+      slot = &_etags[i];
+      break;
+    }
+    if (_etags[i].used < slot->used)
+      slot = &_etags[i];
+  }
+  if (slot->used && slot->file == name && slot->size == size && slot->mtime == mtime) {
+    slot->used = ++_metaTick;
+    return slot->etag;
   }
 
-  return found;
+  uint8_t buf[256];
+  size_t len;
+  while ((len = file.read(buf, sizeof(buf))) > 0)
+    hash = fnv1a(hash, buf, len);
+  file.seek(0);
+  snprintf(tag, sizeof(tag), "\"%08x%08x\"", (unsigned)(hash >> 32), (unsigned)hash);
+  slot->file = name;
+  slot->size = size;
+  slot->mtime = mtime;
+  slot->etag = String(tag);
+  slot->used = ++_metaTick;
+  return slot->etag;
 }
 
-uint8_t AsyncStaticWebHandler::_countBits(const uint8_t value) const
+// The manifest is read on the first lookup after invalidate(), lookups search it for "\n<path>\t"
+bool AsyncStaticWebHandler::_isImmutable(const String& path)
 {
-  uint8_t w = value;
-  uint8_t n;
-  for (n=0; w!=0; n++) w&=w-1;
-  return n;
+  if (_manifestPath.length() == 0)
+    return false;
+  if (_manifest.length() == 0) {
+    _manifest = "\n";
+    File f = _fs.open(_manifestPath, "r");
+    if (f == true) {
+      _manifest.reserve(f.size() + 2);
+      while (f.available())
+        _manifest += (char)f.read();
+      f.close();
+    }
+    if (_manifest[_manifest.length()-1] != '\n')
+      _manifest += '\n';
+  }
+  int at = _manifest.indexOf("\n" + path);
+  while (at >= 0) {
+    char next = _manifest[at + 1 + path.length()];
+    if (next == '\t' || next == '\n' || next == '\r')
+      return true;
+    at = _manifest.indexOf("\n" + path, at + 1);
+  }
+  return false;
 }
 
 void AsyncStaticWebHandler::handleRequest(AsyncWebServerRequest *request)
 {
-  // Get the filename from request->_tempObject and free it
-  String filename = String((char*)request->_tempObject);
-  free(request->_tempObject);
+  // What canHandle() resolved, the memory itself goes away with the request arena
+  AsyncStaticFileInfo* info = (AsyncStaticFileInfo*)request->_tempObject;
   request->_tempObject = NULL;
   if((_username != "" && _password != "") && !request->authenticate(_username.c_str(), _password.c_str()))
       return request->requestAuthentication();
 
-  if (request->_tempFile == true) {
-    String etag = String(request->_tempFile.size());
-    if (_last_modified.length() && _last_modified == request->header("If-Modified-Since")) {
+  String filename = String(info->path);
+  // If-None-Match wins over If-Modified-Since when both are sent (RFC 7232, 6)
+  bool notModified;
+  if (request->hasHeader("If-None-Match"))
+    notModified = info->etag[0] && request->etagMatches(info->etag);
+  else
+    notModified = _last_modified.length() && _last_modified == request->header("If-Modified-Since");
+
+  // content kept in RAM goes out without any file system access, ranges are left to AsyncFileResponse
+  MetaEntry* entry = NULL;
+  if (!notModified && _ramBudget && !_callback && info->size <= _ramMaxFile && !request->hasHeader("Range")
+    && (entry = _findMeta(info->key)) != NULL) {
+    if (entry->content) {
       request->_tempFile.close();
-      request->send(304); // Not modified
-    } else if (_cache_control.length() && request->hasHeader("If-None-Match") && request->header("If-None-Match").equals(etag)) {
+      _ramStats.hits++;
+      return request->send(_cachedResponse(entry->content, info));
+    }
+    _ramStats.misses++;
+  }
+
+  // a metadata cache hit leaves the file to be opened here, and only when its content is sent
+  if (!notModified && !request->_tempFile) {
+    request->_tempFile = _fs.open(info->file, "r");
+    if (!FILE_IS_REAL(request->_tempFile) || request->_tempFile.size() != info->size) {
+      // changed behind our back, resolve it again next time
       request->_tempFile.close();
-      AsyncWebServerResponse * response = new AsyncBasicResponse(304); // Not modified
-      response->addHeader("Cache-Control", _cache_control);
-      response->addHeader("ETag", etag);
-      request->send(response);
-    } else {
-      AsyncWebServerResponse * response = new AsyncFileResponse(request->_tempFile, filename, String(), false, _callback);
-      if (_last_modified.length())
-        response->addHeader("Last-Modified", _last_modified);
-      if (_cache_control.length()){
-        response->addHeader("Cache-Control", _cache_control);
-        response->addHeader("ETag", etag);
-      }
-      request->send(response);
+      invalidate();
+      return request->send(404);
     }
+  }
+
+  if (entry) {
+    // read once here, every later request for it is served from RAM
+    AsyncWebSharedBuffer* content = AsyncWebSharedBuffer::create(NULL, info->size);
+    if (content && request->_tempFile.read(content->data(), info->size) == info->size) {
+      request->_tempFile.close();
+      entry->content = content;
+      _ramStats.bytes += info->size;
+      _fitRamBudget(entry);
+      return request->send(_cachedResponse(content, info));
+    }
+    if (content)
+      content->release();
+    request->_tempFile.seek(0);
+  }
+
+  if (notModified) {
+    // answered from the metadata alone, the file is not opened for it
+    request->_tempFile.close();
+    AsyncWebServerResponse * response = new AsyncBasicResponse(304); // Not modified
+    _addCacheHeaders(response, info);
+    request->send(response);
+  } else if (request->_tempFile == true) {
+    AsyncWebServerResponse * response = new AsyncFileResponse(request->_tempFile, filename, String(), false, _callback);
+    _addCacheHeaders(response, info);
+    request->send(response);
   } else {
     request->send(404);
   }
 }
+
+void AsyncStaticWebHandler::_addCacheHeaders(AsyncWebServerResponse* response, AsyncStaticFileInfo* info)
+{
+  if (_last_modified.length())
+    response->addHeader("Last-Modified", _last_modified);
+  if (info->immutable)
+    response->addHeader("Cache-Control", _immutable_cache_control);
+  else if (_cache_control.length())
+    response->addHeader("Cache-Control", _cache_control);
+  if (info->etag[0])
+    response->addHeader("ETag", info->etag);
+  if (info->vary)
+    response->addHeader("Vary", "Accept-Encoding");
+}
+
+// The same headers AsyncFileResponse and handleRequest() would add, with the body from RAM
+AsyncWebServerResponse* AsyncStaticWebHandler::_cachedResponse(AsyncWebSharedBuffer* content, AsyncStaticFileInfo* info)
+{
+  String path(info->path);
+  AsyncWebServerResponse* response = new AsyncBasicResponse(200, AsyncFileResponse::contentTypeFor(path), content);
+  if (!_callback)
+    response->setAcceptRanges(true); // ranged requests skip the RAM cache
+  for (size_t i = 0; FILE_ENCODINGS[i].coding; i++) {
+    if (String(info->file).endsWith(FILE_ENCODINGS[i].ext) && !path.endsWith(FILE_ENCODINGS[i].ext))
+      response->addHeader("Content-Encoding", FILE_ENCODINGS[i].coding);
+  }
+  response->addHeader("Content-Disposition", "inline; filename=\"" + path.substring(path.lastIndexOf('/') + 1) + "\"");
+  _addCacheHeaders(response, info);
+  return response;
+}
+
+/*
+ * Embedded assets, compiled into the firmware by scripts/build_web.py
+ * */
+
+const AsyncWebAsset* AsyncWebAssetTable::find(const char* path, size_t len) const
+{
+  if (size == 0)
+    return NULL;
+  uint32_t hash = 2166136261UL ^ seed;
+  for (size_t i = 0; i < len; i++)
+    hash = (hash ^ (uint8_t)path[i]) * 16777619UL;
+  int16_t index = slots[hash % size];
+  if (index < 0)
+    return NULL;
+  // the slot only says which asset it would be, any other path lands somewhere too
+  const AsyncWebAsset* asset = &assets[index];
+  if (strlen(asset->path) != len || memcmp(asset->path, path, len) != 0)
+    return NULL;
+  return asset;
+}
+
+AsyncEmbeddedWebHandler::AsyncEmbeddedWebHandler(const char* uri, const AsyncWebAssetTable& assets, const char* cache_control)
+  : _uri(uri), _assets(assets), _default_file("index.html"), _cache_control(cache_control)
+{
+  // Ensure leading '/', the root is "" as for static files
+  if (_uri.length() == 0 || _uri[0] != '/') _uri = "/" + _uri;
+  if (_uri[_uri.length()-1] == '/') _uri = _uri.substring(0, _uri.length()-1);
+}
+
+AsyncEmbeddedWebHandler& AsyncEmbeddedWebHandler::setDefaultFile(const char* filename){
+  _default_file = String(filename);
+  return *this;
+}
+
+AsyncEmbeddedWebHandler& AsyncEmbeddedWebHandler::setCacheControl(const char* cache_control){
+  _cache_control = String(cache_control);
+  return *this;
+}
+
+const AsyncWebAsset* AsyncEmbeddedWebHandler::_find(AsyncWebServerRequest *request) const
+{
+  String path = request->url().substring(_uri.length());
+  if (path.length() && path[0] != '/')
+    return NULL; // "/uriname" is not below "/uri"
+  if (path.length() == 0 || path[path.length()-1] == '/') {
+    if (path.length() == 0)
+      path = "/";
+    path += _default_file;
+  }
+  return _assets.find(path.c_str(), path.length());
+}
+
+bool AsyncEmbeddedWebHandler::canHandle(AsyncWebServerRequest *request){
+  if(request->method() != HTTP_GET
+    || !request->url().startsWith(_uri)
+    || !request->isExpectedRequestedConnType(RCT_DEFAULT, RCT_HTTP)
+    || _find(request) == NULL
+  ){
+    return false;
+  }
+  request->addInterestingHeader("If-None-Match");
+  return true;
+}
+
+void AsyncEmbeddedWebHandler::handleRequest(AsyncWebServerRequest *request)
+{
+  // looked up again, a pointer to flash cannot be left in _tempObject
+  const AsyncWebAsset* asset = _find(request);
+  if (asset == NULL)
+    return request->send(404);
+
+  AsyncWebServerResponse* response;
+  if (request->etagMatches(asset->etag)) {
+    response = new AsyncBasicResponse(304); // Not modified
+  } else {
+#ifdef ESP32
+    // flash is mapped into the address space, lwIP sends straight from it
+    response = new AsyncBasicResponse(200, asset->contentType, asset->data, asset->length);
+#else
+    response = new AsyncProgmemResponse(200, asset->contentType, asset->data, asset->length);
+#endif
+    if (asset->gzip)
+      response->addHeader("Content-Encoding", "gzip");
+  }
+  if (asset->immutable)
+    response->addHeader("Cache-Control", "public, max-age=31536000, immutable");
+  else if (_cache_control.length())
+    response->addHeader("Cache-Control", _cache_control);
+  response->addHeader("ETag", asset->etag);
+  request->send(response);
+}
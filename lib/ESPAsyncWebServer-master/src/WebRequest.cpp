@@ -37,6 +37,10 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* s, AsyncClient* c)
   , _server(s)
   , _handler(NULL)
   , _response(NULL)
+#if ASYNCWEBSERVER_REQUEST_ARENA_SLAB > 0
+  , _arena(_arenaSlab, sizeof(_arenaSlab))
+#endif
+  , _interestingHeaders(&_arena)
   , _temp()
   , _parseState(0)
   , _version(0)
@@ -51,13 +55,27 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* s, AsyncClient* c)
   , _isMultipart(false)
   , _isPlainPost(false)
   , _expectingContinue(false)
+  , _isChunked(false)
   , _contentLength(0)
   , _parsedLength(0)
-  , _headers(LinkedList<AsyncWebHeader *>([](AsyncWebHeader *h){ delete h; }))
-  , _params(LinkedList<AsyncWebParameter *>([](AsyncWebParameter *p){ delete p; }))
-  , _pathParams(LinkedList<String *>([](String *p){ delete p; }))
+  , _chunkState(0)
+  , _chunkRemaining(0)
+  , _headers(LinkedList<AsyncWebHeader *>([](AsyncWebHeader *h){ AsyncWebArena::destroy(h); }, &_arena))
+  , _params(NULL)
+  , _paramHashes(NULL)
+  , _paramCount(0)
+  , _paramCapacity(0)
+  , _queryParamCount(0)
+  , _pendingParams(NULL)
+  , _pendingParamsTail(&_pendingParams)
+  , _paramsDecoded(false)
+  , _pathParams(LinkedList<String *>([](String *p){ AsyncWebArena::destroy(p); }, &_arena))
+  , _pathArgs()
   , _multiParseState(0)
   , _boundaryPosition(0)
+  , _delimiterLength(0)
+  , _delimiter(NULL)
+  , _delimiterSkip(NULL)
   , _itemStartIndex(0)
   , _itemSize(0)
   , _itemName()
@@ -65,8 +83,11 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* s, AsyncClient* c)
   , _itemType()
   , _itemValue()
   , _itemBuffer(0)
-  , _itemBufferIndex(0)
   , _itemIsFile(false)
+  , _bodyPaused(false)
+  , _bodyUnacked(0)
+  , _bodyResume(nullptr)
+  , _bodyWaker(NULL)
   , _tempObject(NULL)
 {
   c->onError([](void *r, AsyncClient* c, int8_t error){ (void)c; AsyncWebServerRequest *req = (AsyncWebServerRequest*)r; req->_onError(error); }, this);
@@ -80,7 +101,9 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* s, AsyncClient* c)
 AsyncWebServerRequest::~AsyncWebServerRequest(){
   _headers.free();
 
-  _params.free();
+  for(size_t i = 0; i < _paramCount; i++)
+    AsyncWebArena::destroy(_params[i]);
+  _paramCount = 0;
   _pathParams.free();
 
   _interestingHeaders.free();
@@ -89,16 +112,28 @@ AsyncWebServerRequest::~AsyncWebServerRequest(){
     delete _response;
   }
 
-  if(_tempObject != NULL){
+  if(_tempObject != NULL && !_arena.owns(_tempObject)){
     free(_tempObject);
   }
 
   if(_tempFile){
     _tempFile.close();
   }
+
+  if(_bodyWaker){
+    _bodyWaker->_request = NULL;
+    _bodyWaker->release();
+  }
+  // everything allocated from _arena is released with it
+}
+
+void AsyncWebServerRequest::operator delete(void* ptr){
+  if(!AsyncWebPool::release(ptr))
+    ::operator delete(ptr);
 }
 
 void AsyncWebServerRequest::_onData(void *buf, size_t len){
+  size_t packetLength = len;
   size_t i = 0;
   while (true) {
 
@@ -129,58 +164,233 @@ void AsyncWebServerRequest::_onData(void *buf, size_t len){
       }
     }
   } else if(_parseState == PARSE_REQ_BODY){
-    // A handler should be already attached at this point in _parseLine function.
-    // If handler does nothing (_onRequest is NULL), we don't need to really parse the body.
-    const bool needParse = _handler && !_handler->isRequestHandlerTrivial();
-    if(_isMultipart){
-      if(needParse){
-        size_t i;
-        for(i=0; i<len; i++){
-          _parseMultipartPostByte(((uint8_t*)buf)[i], i == len - 1);
-          _parsedLength++;
-        }
-      } else
-          _parsedLength += len;
+    if(_isChunked){
+      if(_parseChunkedBody((uint8_t*)buf, len))
+        _bodyEnd();
     } else {
-      if(_parsedLength == 0){
-        if(_contentType.startsWith("application/x-www-form-urlencoded")){
+      _parseBody((uint8_t*)buf, len, _parsedLength + len >= _contentLength);
+      if(_parseState == PARSE_REQ_BODY && _parsedLength == _contentLength)
+        _bodyEnd();
+    }
+  }
+  break;
+  }
+  _checkBodyResume();
+  if(_bodyPaused){
+    // keep the window closed until resumeBody()
+    _client->ackLater();
+    _bodyUnacked += packetLength;
+  }
+}
+
+void AsyncWebServerRequest::_parseBody(uint8_t* data, size_t len, bool last){
+#if ASYNCWEBSERVER_MAX_BODY_SIZE > 0
+  if(_parsedLength + len > ASYNCWEBSERVER_MAX_BODY_SIZE){
+    _bodyError(413);
+    return;
+  }
+#endif
+  // A handler should be already attached at this point in _parseLine function.
+  // If handler does nothing (_onRequest is NULL), we don't need to really parse the body.
+  const bool needParse = _handler && !_handler->isRequestHandlerTrivial();
+  if(_isMultipart){
+    if(needParse && len)
+      _parseMultipartPost(data, len);
+    _parsedLength += len;
+  } else {
+    if(_parsedLength == 0 && len){
+      if(_contentType.startsWith("application/x-www-form-urlencoded")){
+        _isPlainPost = true;
+      } else if(_contentType == "text/plain" && __is_param_char(((char*)data)[0])){
+        size_t i = 0;
+        while (i<len && __is_param_char(((char*)data)[i++]));
+        if(i < len && ((char*)data)[i-1] == '='){
           _isPlainPost = true;
-        } else if(_contentType == "text/plain" && __is_param_char(((char*)buf)[0])){
-          size_t i = 0;
-          while (i<len && __is_param_char(((char*)buf)[i++]));
-          if(i < len && ((char*)buf)[i-1] == '='){
-            _isPlainPost = true;
-          }
         }
       }
-      if(!_isPlainPost) {
-        //check if authenticated before calling the body
-        if(_handler) _handler->handleBody(this, (uint8_t*)buf, len, _parsedLength, _contentLength);
-        _parsedLength += len;
-      } else if(needParse) {
-        size_t i;
-        for(i=0; i<len; i++){
-          _parsedLength++;
-          _parsePlainPostChar(((uint8_t*)buf)[i]);
+    }
+    if(!_isPlainPost) {
+      //check if authenticated before calling the body
+      if(_handler && len) _handler->handleBody(this, data, len, _parsedLength, _contentLength);
+      _parsedLength += len;
+    } else if(needParse) {
+      _parsedLength += len;
+      _parsePlainPost(data, len, last);
+    } else {
+      _parsedLength += len;
+    }
+  }
+}
+
+enum { CHUNK_SIZE_START, CHUNK_SIZE, CHUNK_SIZE_END, CHUNK_EXTENSION, CHUNK_SIZE_CR, CHUNK_DATA, CHUNK_DATA_END, CHUNK_TRAILER, CHUNK_TRAILER_LINE };
+
+// Transfer-Encoding: chunked, the chunk data is passed on in place. Returns true after the last chunk
+bool AsyncWebServerRequest::_parseChunkedBody(uint8_t* data, size_t len){
+  uint8_t* end = data + len;
+  while(data < end && _parseState == PARSE_REQ_BODY){
+    if(_chunkState == CHUNK_DATA){
+      size_t n = (size_t)(end - data) < _chunkRemaining ? end - data : _chunkRemaining;
+      _parseBody(data, n, false);
+      data += n;
+      _chunkRemaining -= n;
+      if(!_chunkRemaining)
+        _chunkState = CHUNK_DATA_END;
+      continue;
+    }
+    char c = *data++;
+    if(_chunkState == CHUNK_SIZE_START || _chunkState == CHUNK_SIZE){
+      int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+      if(digit >= 0){
+        if(_chunkRemaining > (SIZE_MAX >> 4)){
+          _bodyError(413);
+          return false;
         }
-      } else {
-        _parsedLength += len;
+        _chunkRemaining = (_chunkRemaining << 4) | digit;
+        _chunkState = CHUNK_SIZE;
+        continue;
+      }
+      if(_chunkState == CHUNK_SIZE_START){
+        _bodyError(400);
+        return false;
       }
+      _chunkState = CHUNK_SIZE_END;
     }
-    if(_parsedLength == _contentLength){
-      _parseState = PARSE_REQ_END;
-      //check if authenticated before calling handleRequest and request auth instead
-      if(_handler) _handler->handleRequest(this);
-      else send(501);
+    if(_chunkState == CHUNK_SIZE_END){
+      // past the digits only whitespace, an extension or the line end may follow
+      if(c == ' ' || c == '\t')
+        continue;
+      if(c == ';'){
+        _chunkState = CHUNK_EXTENSION;
+        continue;
+      }
+      if(c == '\r'){
+        _chunkState = CHUNK_SIZE_CR;
+        continue;
+      }
+      if(c != '\n'){
+        _bodyError(400);
+        return false;
+      }
+    } else if(_chunkState == CHUNK_EXTENSION){
+      if(c == '\r'){
+        _chunkState = CHUNK_SIZE_CR;
+        continue;
+      }
+      if(c != '\n')
+        continue;
+    } else if(_chunkState == CHUNK_SIZE_CR){
+      if(c != '\n'){
+        _bodyError(400);
+        return false;
+      }
+    } else if(_chunkState == CHUNK_DATA_END){
+      if(c == '\r')
+        continue;
+      if(c != '\n'){
+        _bodyError(400);
+        return false;
+      }
+      _chunkState = CHUNK_SIZE_START;
+      continue;
+    } else if(_chunkState == CHUNK_TRAILER){
+      if(c == '\r')
+        continue;
+      if(c == '\n'){
+        // an empty line ends the body, the total length is known now
+        _parseBody(data, 0, true);
+        _contentLength = _parsedLength;
+        return _parseState == PARSE_REQ_BODY;
+      }
+      _chunkState = CHUNK_TRAILER_LINE;
+      continue;
+    } else {
+      if(c == '\n')
+        _chunkState = CHUNK_TRAILER;
+      continue;
     }
+    // end of a chunk size line
+    _chunkState = _chunkRemaining ? CHUNK_DATA : CHUNK_TRAILER;
   }
-  break;
+  return false;
+}
+
+void AsyncWebServerRequest::_bodyEnd(){
+  _parseState = PARSE_REQ_END;
+  //check if authenticated before calling handleRequest and request auth instead
+  if(_handler) _handler->handleRequest(this);
+  else send(501);
+}
+
+void AsyncWebServerRequest::_bodyError(int code){
+  // whatever else the client sends is ignored, the connection closes once the response is out
+  _parseState = PARSE_REQ_FAIL;
+  send(code);
+}
+
+void AsyncWebServerRequest::pauseBody(ArBodyResumeFunction canResume){
+  _bodyPaused = true;
+  _bodyResume = canResume;
+}
+
+void AsyncWebServerRequest::resumeBody(){
+  _bodyPaused = false;
+  _bodyResume = nullptr;
+  if(_bodyUnacked){
+    _client->ack(_bodyUnacked);
+    _bodyUnacked = 0;
+  }
+}
+
+void AsyncWebServerRequest::_checkBodyResume(){
+  if(_bodyPaused && _bodyResume && _bodyResume())
+    resumeBody();
+}
+
+AsyncWebBodyWaker* AsyncWebServerRequest::bodyWaker(){
+  if(_bodyWaker == NULL)
+    _bodyWaker = new AsyncWebBodyWaker(this);
+  _bodyWaker->_refs.fetch_add(1, std::memory_order_relaxed);
+  return _bodyWaker;
+}
+
+void AsyncWebBodyWaker::wake(){
+  if(_pending.exchange(true, std::memory_order_acq_rel))
+    return;
+#ifdef ESP32
+  // the queued call holds a reference, so the waker outlives it even if the request is deleted meanwhile
+  _refs.fetch_add(1, std::memory_order_relaxed);
+  if(!AsyncClient::call(_run, this)){
+    _pending.store(false, std::memory_order_release);
+    release(); // the caller still holds its own, the next poll checks again
   }
+#else
+  _run(this);
+#endif
+}
+
+void AsyncWebBodyWaker::_run(void* arg){
+  AsyncWebBodyWaker* waker = (AsyncWebBodyWaker*)arg;
+  waker->_pending.store(false, std::memory_order_release);
+  AsyncWebServerRequest* request = waker->_request;
+  if(request && request->_bodyPaused && (!request->_bodyResume || request->_bodyResume()))
+    request->resumeBody();
+#ifdef ESP32
+  waker->release();
+#endif
+}
+
+void AsyncWebBodyWaker::release(){
+  if(_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete this;
 }
 
 void AsyncWebServerRequest::_removeNotInterestingHeaders(){
   if (_interestingHeaders.containsIgnoreCase("ANY")) return; // nothing to do
   for(const auto& header: _headers){
+      // kept for file responses, compression and response caches, whichever handler sends them
+      if(header->name().equalsIgnoreCase("Range") || header->name().equalsIgnoreCase("If-Range")
+        || header->name().equalsIgnoreCase("Accept-Encoding") || header->name().equalsIgnoreCase("If-None-Match"))
+        continue;
       if(!_interestingHeaders.containsIgnoreCase(header->name().c_str())){
         _headers.remove(header);
       }
@@ -189,6 +399,7 @@ void AsyncWebServerRequest::_removeNotInterestingHeaders(){
 
 void AsyncWebServerRequest::_onPoll(){
   //os_printf("p\n");
+  _checkBodyResume();
   if(_response != NULL && _client != NULL && _client->canSend() && !_response->_finished()){
     _response->_ack(this, 0, 0);
   }
@@ -196,6 +407,7 @@ void AsyncWebServerRequest::_onPoll(){
 
 void AsyncWebServerRequest::_onAck(size_t len, uint32_t time){
   //os_printf("a:%u:%u\n", len, time);
+  _checkBodyResume();
   if(_response != NULL){
     if(!_response->_finished()){
       _response->_ack(this, len, time);
@@ -229,26 +441,167 @@ void AsyncWebServerRequest::_onDisconnect(){
   _server->_handleDisconnect(this);
 }
 
-void AsyncWebServerRequest::_addParam(AsyncWebParameter *p){
-  _params.add(p);
+static uint16_t paramHash(const char* name, size_t len){
+  uint32_t h = 2166136261UL;
+  while(len--){
+    h ^= (uint8_t)*name++;
+    h *= 16777619UL;
+  }
+  return (uint16_t)(h ^ (h >> 16));
 }
 
-void AsyncWebServerRequest::_addPathParam(const char *p){
-  _pathParams.add(new String(p));
+// Same decoding as urlDecode(), done in place since the result is never longer
+static size_t urlDecodeInPlace(char* text, size_t len){
+  char temp[] = "0x00";
+  size_t i = 0, o = 0;
+  while(i < len){
+    char encodedChar = text[i++];
+    if((encodedChar == '%') && (i + 1 < len)){
+      temp[2] = text[i++];
+      temp[3] = text[i++];
+      text[o++] = strtol(temp, NULL, 16);
+    } else if(encodedChar == '+'){
+      text[o++] = ' ';
+    } else {
+      text[o++] = encodedChar;
+    }
+  }
+  text[o] = 0;
+  return o;
 }
 
-void AsyncWebServerRequest::_addGetParams(const String& params){
-  size_t start = 0;
-  while (start < params.length()){
-    int end = params.indexOf('&', start);
-    if (end < 0) end = params.length();
-    int equal = params.indexOf('=', start);
-    if (equal < 0 || equal > end) equal = end;
-    String name = params.substring(start, equal);
-    String value = equal + 1 < end ? params.substring(equal + 1, end) : String();
-    _addParam(new AsyncWebParameter(urlDecode(name), urlDecode(value)));
-    start = end + 1;
+// Appends len bytes that are not null terminated, the same way _onData() builds _temp
+static void concatBytes(String& str, uint8_t* data, size_t len){
+  if(!len)
+    return;
+  str.reserve(str.length() + len);
+  char last = data[len - 1];
+  data[len - 1] = 0;
+  str.concat((const char*)data);
+  data[len - 1] = last;
+  str.concat(last);
+}
+
+bool AsyncWebServerRequest::_insertParam(size_t index, AsyncWebParameter* param){
+  if(_paramCount == _paramCapacity){
+    // the old table stays in the arena until the request is gone, parameter counts are small
+    size_t capacity = _paramCapacity ? _paramCapacity * 2 : 4;
+    AsyncWebParameter** params = (AsyncWebParameter**)_arena.alloc(capacity * sizeof(AsyncWebParameter*), alignof(AsyncWebParameter*));
+    uint16_t* hashes = (uint16_t*)_arena.alloc(capacity * sizeof(uint16_t), alignof(uint16_t));
+    if(params == NULL || hashes == NULL)
+      return false;
+    if(_paramCount){
+      memcpy(params, _params, _paramCount * sizeof(AsyncWebParameter*));
+      memcpy(hashes, _paramHashes, _paramCount * sizeof(uint16_t));
+    }
+    _params = params;
+    _paramHashes = hashes;
+    _paramCapacity = capacity;
   }
+  memmove(_params + index + 1, _params + index, (_paramCount - index) * sizeof(AsyncWebParameter*));
+  memmove(_paramHashes + index + 1, _paramHashes + index, (_paramCount - index) * sizeof(uint16_t));
+  _params[index] = param;
+  _paramHashes[index] = paramHash(param->name().c_str(), param->name().length());
+  _paramCount++;
+  return true;
+}
+
+void AsyncWebServerRequest::_addParam(const String& name, const String& value, bool form, bool file, size_t size){
+  AsyncWebParameter* p = _arena.create<AsyncWebParameter>(name, value, form, file, size);
+  if(p && !_insertParam(_paramCount, p))
+    AsyncWebArena::destroy(p);
+}
+
+// Query parameters are split on '&' only, form fields also on NUL and without a name become "body"
+void AsyncWebServerRequest::_parseParams(char* text, size_t len, bool form){
+  char* end = text + len;
+  while(text < end){
+    char* amp = text;
+    while(amp < end && *amp != '&' && (*amp || !form))
+      amp++;
+    char* equal = (char*)memchr(text, '=', amp - text);
+    const char* name = text;
+    char* value = amp;
+    if(form && (equal == NULL || equal == text || *text == '{' || *text == '[')){
+      name = "body";
+      value = text;
+      equal = text;
+    } else if(equal == NULL){
+      equal = amp;
+    } else {
+      value = equal + 1;
+    }
+    size_t valueLength = urlDecodeInPlace(value, amp - value);
+    if(equal > text)
+      urlDecodeInPlace(text, equal - text);
+    else if(name == text)
+      *text = 0;
+    AsyncWebParameter* p = _arena.create<AsyncWebParameter>(String(name), valueLength ? String(value) : String(), form);
+    if(p){
+      // query parameters stay in front of everything else
+      if(!_insertParam(form ? _paramCount : _queryParamCount, p))
+        AsyncWebArena::destroy(p);
+      else if(!form)
+        _queryParamCount++;
+    }
+    text = amp + 1;
+  }
+}
+
+void AsyncWebServerRequest::_addPendingParams(const char* text, size_t len, bool form){
+  if(!len)
+    return;
+  char* copy = _arena.strdup(text, len);
+  if(copy == NULL)
+    return;
+  if(_paramsDecoded){
+    // parameters were already looked at, decode right away
+    _parseParams(copy, len, form);
+    return;
+  }
+  // keep the raw text, nothing is split or decoded until a handler asks for a parameter
+  PendingParams* pending = _arena.create<PendingParams>();
+  if(pending == NULL)
+    return;
+  pending->text = copy;
+  pending->len = len;
+  pending->form = form;
+  pending->next = NULL;
+  *_pendingParamsTail = pending;
+  _pendingParamsTail = &pending->next;
+}
+
+void AsyncWebServerRequest::_decodeParams() const {
+  if(_paramsDecoded)
+    return;
+  // parameters are looked up through const accessors, decoding them is not a visible change
+  AsyncWebServerRequest* self = const_cast<AsyncWebServerRequest*>(this);
+  self->_paramsDecoded = true;
+  for(PendingParams* p = _pendingParams; p; p = p->next)
+    self->_parseParams(p->text, p->len, p->form);
+  self->_pendingParams = NULL;
+  self->_pendingParamsTail = &self->_pendingParams;
+}
+
+AsyncWebParameter* AsyncWebServerRequest::_findParam(const char* name, size_t len, bool any, bool post, bool file) const {
+  _decodeParams();
+  uint16_t hash = paramHash(name, len);
+  for(size_t i = 0; i < _paramCount; i++){
+    AsyncWebParameter* p = _params[i];
+    if(_paramHashes[i] == hash && p->name().length() == len && !memcmp(p->name().c_str(), name, len)
+      && (any || (p->isPost() == post && p->isFile() == file)))
+      return p;
+  }
+  return nullptr;
+}
+
+void AsyncWebServerRequest::_setPathArgs(const AsyncWebPathArgs& args){
+  _pathArgs = args;
+  _pathParams.free();
+}
+
+void AsyncWebServerRequest::_addGetParams(const String& params){
+  _addPendingParams(params.c_str(), params.length(), false);
 }
 
 bool AsyncWebServerRequest::_parseReqHead(){
@@ -325,6 +678,8 @@ bool AsyncWebServerRequest::_parseReqHeader(){
       }
     } else if(name.equalsIgnoreCase("Content-Length")){
       _contentLength = atoi(value.c_str());
+    } else if(name.equalsIgnoreCase("Transfer-Encoding")){
+      _isChunked = strContains(value, "chunked", false);
     } else if(name.equalsIgnoreCase("Expect") && value == "100-continue"){
       _expectingContinue = true;
     } else if(name.equalsIgnoreCase("Authorization")){
@@ -345,210 +700,260 @@ bool AsyncWebServerRequest::_parseReqHeader(){
         }
       }
     }
-    _headers.add(new AsyncWebHeader(name, value));
+    AsyncWebHeader* h = _arena.create<AsyncWebHeader>(name, value);
+    if(h)
+      _headers.add(h);
   }
   _temp = String();
   return true;
 }
 
-void AsyncWebServerRequest::_parsePlainPostChar(uint8_t data){
-  if(data && (char)data != '&')
-    _temp += (char)data;
-  if(!data || (char)data == '&' || _parsedLength == _contentLength){
-    String name = "body";
-    String value = _temp;
-    if(!_temp.startsWith("{") && !_temp.startsWith("[") && _temp.indexOf('=') > 0){
-      name = _temp.substring(0, _temp.indexOf('='));
-      value = _temp.substring(_temp.indexOf('=') + 1);
-    }
-    _addParam(new AsyncWebParameter(urlDecode(name), urlDecode(value), true));
-    _temp = String();
+void AsyncWebServerRequest::_parsePlainPost(uint8_t* data, size_t len, bool last){
+  // complete fields are stored as they are, only a field cut by the end of the segment is carried in _temp
+  uint8_t* end = data + len;
+  uint8_t* cut = end;
+  if(!last){
+    while(cut > data && cut[-1] != '&' && cut[-1])
+      cut--;
   }
-}
-
-void AsyncWebServerRequest::_handleUploadByte(uint8_t data, bool last){
-  _itemBuffer[_itemBufferIndex++] = data;
-
-  if(last || _itemBufferIndex == 1460){
-    //check if authenticated before calling the upload
-    if(_handler)
-      _handler->handleUpload(this, _itemFilename, _itemSize - _itemBufferIndex, _itemBuffer, _itemBufferIndex, false);
-    _itemBufferIndex = 0;
+  if(_temp.length() && (cut > data || last)){
+    // finish the carried field with the start of this segment
+    uint8_t* sep = data;
+    while(sep < cut && *sep != '&' && *sep)
+      sep++;
+    concatBytes(_temp, data, sep - data);
+    _addPendingParams(_temp.c_str(), _temp.length(), true);
+    _temp = String();
+    data = (sep < cut) ? sep + 1 : cut;
   }
+  _addPendingParams((const char*)data, cut - data, true);
+  concatBytes(_temp, cut, end - cut);
 }
 
 enum {
   EXPECT_BOUNDARY,
   PARSE_HEADERS,
-  WAIT_FOR_RETURN1,
-  EXPECT_FEED1,
-  EXPECT_DASH1,
-  EXPECT_DASH2,
-  BOUNDARY_OR_DATA,
-  DASH3_OR_RETURN2,
+  PARSE_DATA,
+  AFTER_BOUNDARY,
   EXPECT_FEED2,
   PARSING_FINISHED,
   PARSE_ERROR
 };
 
-void AsyncWebServerRequest::_parseMultipartPostByte(uint8_t data, bool last){
-#define itemWriteByte(b) do { _itemSize++; if(_itemIsFile) _handleUploadByte(b, last); else _itemValue+=(char)(b); } while(0)
+// Boyer-Moore-Horspool, the delimiter is short and its last byte is rare in payload data
+static uint8_t* findDelimiter(uint8_t* p, uint8_t* end, const uint8_t* d, size_t dl, const uint8_t* skip){
+  while((size_t)(end - p) >= dl){
+    uint8_t last = p[dl - 1];
+    if(last == d[dl - 1] && !memcmp(p, d, dl - 1))
+      return p;
+    p += skip[last];
+  }
+  return NULL;
+}
+
+void AsyncWebServerRequest::_multipartItemData(uint8_t* data, size_t len){
+  if(!len)
+    return;
+  _itemSize += len;
+  if(!_itemIsFile)
+    concatBytes(_itemValue, data, len);
+  else if(_handler) //check if authenticated before calling the upload
+    _handler->handleUpload(this, _itemFilename, _itemSize - len, data, len, false);
+}
+
+void AsyncWebServerRequest::_multipartItemEnd(uint8_t* data, size_t len){
+  _itemSize += len;
+  if(!_itemIsFile){
+    concatBytes(_itemValue, data, len);
+    _addParam(_itemName, _itemValue, true);
+  } else if(_itemSize){
+    if(_handler) _handler->handleUpload(this, _itemFilename, _itemSize - len, data, len, true);
+    _addParam(_itemName, _itemFilename, true, true, _itemSize);
+  }
+  _itemValue = String();
+}
+
+void AsyncWebServerRequest::_parseMultipartHeader(){
+  if(_temp.length() > 12 && _temp.substring(0, 12).equalsIgnoreCase("Content-Type")){
+    _itemType = _temp.substring(14);
+    _itemIsFile = true;
+  } else if(_temp.length() > 19 && _temp.substring(0, 19).equalsIgnoreCase("Content-Disposition")){
+    _temp = _temp.substring(_temp.indexOf(';') + 2);
+    while(_temp.indexOf(';') > 0){
+      String name = _temp.substring(0, _temp.indexOf('='));
+      String nameVal = _temp.substring(_temp.indexOf('=') + 2, _temp.indexOf(';') - 1);
+      if(name == "name"){
+        _itemName = nameVal;
+      } else if(name == "filename"){
+        _itemFilename = nameVal;
+        _itemIsFile = true;
+      }
+      _temp = _temp.substring(_temp.indexOf(';') + 2);
+    }
+    String name = _temp.substring(0, _temp.indexOf('='));
+    String nameVal = _temp.substring(_temp.indexOf('=') + 2, _temp.length() - 1);
+    if(name == "name"){
+      _itemName = nameVal;
+    } else if(name == "filename"){
+      _itemFilename = nameVal;
+      _itemIsFile = true;
+    }
+  }
+}
 
+/*
+ * The body is scanned a whole segment at a time. Item data between two delimiters is handed to
+ * handleUpload() straight out of the receive buffer, only a delimiter split over two segments is
+ * held back until the next segment tells whether it really was one.
+ * */
+void AsyncWebServerRequest::_parseMultipartPost(uint8_t* data, size_t len){
   if(!_parsedLength){
     _multiParseState = EXPECT_BOUNDARY;
+    _boundaryPosition = 0;
     _temp = String();
     _itemName = String();
     _itemFilename = String();
     _itemType = String();
-  }
-
-  if(_multiParseState == WAIT_FOR_RETURN1){
-    if(data != '\r'){
-      itemWriteByte(data);
-    } else {
-      _multiParseState = EXPECT_FEED1;
+    size_t dl = _boundary.length() + 4;
+    if(_delimiter == NULL && _boundary.length() && dl <= 255){
+      _delimiter = (uint8_t*)_arena.alloc(dl, 1);
+      _delimiterSkip = (uint8_t*)_arena.alloc(256, 1);
+      _itemBuffer = (uint8_t*)_arena.alloc(dl, 1);
     }
-  } else if(_multiParseState == EXPECT_BOUNDARY){
-    if(_parsedLength < 2 && data != '-'){
+    if(_delimiter == NULL || _delimiterSkip == NULL || _itemBuffer == NULL){
       _multiParseState = PARSE_ERROR;
       return;
-    } else if(_parsedLength - 2 < _boundary.length() && _boundary.c_str()[_parsedLength - 2] != data){
-      _multiParseState = PARSE_ERROR;
-      return;
-    } else if(_parsedLength - 2 == _boundary.length() && data != '\r'){
-      _multiParseState = PARSE_ERROR;
-      return;
-    } else if(_parsedLength - 3 == _boundary.length()){
-      if(data != '\n'){
+    }
+    _delimiterLength = dl;
+    memcpy(_delimiter, "\r\n--", 4);
+    memcpy(_delimiter + 4, _boundary.c_str(), _boundary.length());
+    memset(_delimiterSkip, dl, 256);
+    for(size_t i = 0; i < dl - 1; i++)
+      _delimiterSkip[_delimiter[i]] = dl - 1 - i;
+  }
+
+  const uint8_t* d = _delimiter;
+  const size_t dl = _delimiterLength;
+  uint8_t* p = data;
+  uint8_t* end = data + len;
+  // data in front of a delimiter waits here until we know whether the item ends
+  uint8_t* tail = NULL;
+  size_t tailLength = 0;
+
+  while(p < end){
+    if(_multiParseState == EXPECT_BOUNDARY){
+      // "--boundary\r\n" has to open the body
+      uint8_t expected = (_boundaryPosition < dl - 2) ? d[_boundaryPosition + 2] : (_boundaryPosition == dl - 2) ? '\r' : '\n';
+      if(*p++ != expected){
         _multiParseState = PARSE_ERROR;
         return;
       }
-      _multiParseState = PARSE_HEADERS;
-      _itemIsFile = false;
-    }
-  } else if(_multiParseState == PARSE_HEADERS){
-    if((char)data != '\r' && (char)data != '\n')
-       _temp += (char)data;
-    if((char)data == '\n'){
+      if(++_boundaryPosition == dl){
+        _multiParseState = PARSE_HEADERS;
+        _itemIsFile = false;
+      }
+    } else if(_multiParseState == PARSE_HEADERS){
+      uint8_t* nl = (uint8_t*)memchr(p, '\n', end - p);
+      uint8_t* stop = nl ? nl : end;
+      concatBytes(_temp, p, stop - p);
+      p = stop;
+      if(nl == NULL)
+        break;
+      p++;
+      if(_temp.length() && _temp.charAt(_temp.length() - 1) == '\r')
+        _temp.remove(_temp.length() - 1);
       if(_temp.length()){
-        if(_temp.length() > 12 && _temp.substring(0, 12).equalsIgnoreCase("Content-Type")){
-          _itemType = _temp.substring(14);
-          _itemIsFile = true;
-        } else if(_temp.length() > 19 && _temp.substring(0, 19).equalsIgnoreCase("Content-Disposition")){
-          _temp = _temp.substring(_temp.indexOf(';') + 2);
-          while(_temp.indexOf(';') > 0){
-            String name = _temp.substring(0, _temp.indexOf('='));
-            String nameVal = _temp.substring(_temp.indexOf('=') + 2, _temp.indexOf(';') - 1);
-            if(name == "name"){
-              _itemName = nameVal;
-            } else if(name == "filename"){
-              _itemFilename = nameVal;
-              _itemIsFile = true;
-            }
-            _temp = _temp.substring(_temp.indexOf(';') + 2);
-          }
-          String name = _temp.substring(0, _temp.indexOf('='));
-          String nameVal = _temp.substring(_temp.indexOf('=') + 2, _temp.length() - 1);
-          if(name == "name"){
-            _itemName = nameVal;
-          } else if(name == "filename"){
-            _itemFilename = nameVal;
-            _itemIsFile = true;
-          }
-        }
+        _parseMultipartHeader();
         _temp = String();
       } else {
-        _multiParseState = WAIT_FOR_RETURN1;
         //value starts from here
+        _multiParseState = PARSE_DATA;
+        _boundaryPosition = 0;
         _itemSize = 0;
-        _itemStartIndex = _parsedLength;
+        _itemStartIndex = _parsedLength + (p - data);
         _itemValue = String();
-        if(_itemIsFile){
-          if(_itemBuffer)
-            free(_itemBuffer);
-          _itemBuffer = (uint8_t*)malloc(1460);
-          if(_itemBuffer == NULL){
-            _multiParseState = PARSE_ERROR;
-            return;
-          }
-          _itemBufferIndex = 0;
+      }
+    } else if(_multiParseState == PARSE_DATA){
+      if(_boundaryPosition){
+        // the previous segment ended with the start of a delimiter
+        while(p < end && _boundaryPosition < dl && *p == d[_boundaryPosition]){
+          p++;
+          _boundaryPosition++;
+        }
+        if(_boundaryPosition == dl){
+          _boundaryPosition = 0;
+          _multiParseState = AFTER_BOUNDARY;
+          continue;
         }
+        if(p == end)
+          break;
+        // '\r' only appears once in the delimiter, so all of the held back bytes are data
+        memcpy(_itemBuffer, d, _boundaryPosition);
+        _multipartItemData(_itemBuffer, _boundaryPosition);
+        _boundaryPosition = 0;
+        continue;
       }
-    }
-  } else if(_multiParseState == EXPECT_FEED1){
-    if(data != '\n'){
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); _parseMultipartPostByte(data, last);
-    } else {
-      _multiParseState = EXPECT_DASH1;
-    }
-  } else if(_multiParseState == EXPECT_DASH1){
-    if(data != '-'){
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); itemWriteByte('\n');  _parseMultipartPostByte(data, last);
-    } else {
-      _multiParseState = EXPECT_DASH2;
-    }
-  } else if(_multiParseState == EXPECT_DASH2){
-    if(data != '-'){
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); itemWriteByte('\n'); itemWriteByte('-');  _parseMultipartPostByte(data, last);
-    } else {
-      _multiParseState = BOUNDARY_OR_DATA;
-      _boundaryPosition = 0;
-    }
-  } else if(_multiParseState == BOUNDARY_OR_DATA){
-    if(_boundaryPosition < _boundary.length() && _boundary.c_str()[_boundaryPosition] != data){
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); itemWriteByte('\n'); itemWriteByte('-');  itemWriteByte('-');
-      uint8_t i;
-      for(i=0; i<_boundaryPosition; i++)
-        itemWriteByte(_boundary.c_str()[i]);
-      _parseMultipartPostByte(data, last);
-    } else if(_boundaryPosition == _boundary.length() - 1){
-      _multiParseState = DASH3_OR_RETURN2;
-      if(!_itemIsFile){
-        _addParam(new AsyncWebParameter(_itemName, _itemValue, true));
-      } else {
-        if(_itemSize){
-          //check if authenticated before calling the upload
-          if(_handler) _handler->handleUpload(this, _itemFilename, _itemSize - _itemBufferIndex, _itemBuffer, _itemBufferIndex, true);
-          _itemBufferIndex = 0;
-          _addParam(new AsyncWebParameter(_itemName, _itemFilename, true, true, _itemSize));
+      uint8_t* hit = findDelimiter(p, end, d, dl, _delimiterSkip);
+      if(hit){
+        tail = p;
+        tailLength = hit - p;
+        p = hit + dl;
+        _multiParseState = AFTER_BOUNDARY;
+        continue;
+      }
+      // keep back what could be the start of a delimiter
+      uint8_t* split = end;
+      size_t avail = end - p;
+      for(size_t n = 1; n < dl && n <= avail; n++){
+        if(end[-n] == '\r'){
+          if(!memcmp(end - n, d, n))
+            split = end - n;
+          break;
         }
-        free(_itemBuffer);
-        _itemBuffer = NULL;
       }
-
-    } else {
-      _boundaryPosition++;
-    }
-  } else if(_multiParseState == DASH3_OR_RETURN2){
-    if(data == '-' && (_contentLength - _parsedLength - 4) != 0){
-      //os_printf("ERROR: The parser got to the end of the POST but is expecting %u bytes more!\nDrop an issue so we can have more info on the matter!\n", _contentLength - _parsedLength - 4);
-      _contentLength = _parsedLength + 4;//lets close the request gracefully
-    }
-    if(data == '\r'){
-      _multiParseState = EXPECT_FEED2;
-    } else if(data == '-' && _contentLength == (_parsedLength + 4)){
-      _multiParseState = PARSING_FINISHED;
-    } else {
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); itemWriteByte('\n'); itemWriteByte('-');  itemWriteByte('-');
-      uint8_t i; for(i=0; i<_boundary.length(); i++) itemWriteByte(_boundary.c_str()[i]);
-      _parseMultipartPostByte(data, last);
-    }
-  } else if(_multiParseState == EXPECT_FEED2){
-    if(data == '\n'){
+      _multipartItemData(p, split - p);
+      _boundaryPosition = end - split;
+      p = end;
+    } else if(_multiParseState == AFTER_BOUNDARY){
+      size_t pos = _parsedLength + (p - data);
+      if(*p == '-' || *p == '\r'){
+        _multipartItemEnd(tail ? tail : _itemBuffer, tailLength);
+        tail = NULL;
+        tailLength = 0;
+      }
+      if(*p == '-'){
+        if(!_isChunked && _contentLength != pos + 4){
+          //os_printf("ERROR: The parser got to the end of the POST but is expecting %u bytes more!\nDrop an issue so we can have more info on the matter!\n", _contentLength - pos - 4);
+          _contentLength = pos + 4;//lets close the request gracefully
+        }
+        _multiParseState = PARSING_FINISHED;
+        return;
+      } else if(*p == '\r'){
+        _multiParseState = EXPECT_FEED2;
+        p++;
+      } else {
+        // not a delimiter after all
+        _multipartItemData(tail, tailLength);
+        tail = NULL;
+        tailLength = 0;
+        memcpy(_itemBuffer, d, dl);
+        _multipartItemData(_itemBuffer, dl);
+        _multiParseState = PARSE_DATA;
+      }
+    } else if(_multiParseState == EXPECT_FEED2){
+      if(*p++ != '\n'){
+        _multiParseState = PARSE_ERROR;
+        return;
+      }
       _multiParseState = PARSE_HEADERS;
       _itemIsFile = false;
     } else {
-      _multiParseState = WAIT_FOR_RETURN1;
-      itemWriteByte('\r'); itemWriteByte('\n'); itemWriteByte('-');  itemWriteByte('-');
-      uint8_t i; for(i=0; i<_boundary.length(); i++) itemWriteByte(_boundary.c_str()[i]);
-      itemWriteByte('\r'); _parseMultipartPostByte(data, last);
+      // PARSING_FINISHED or PARSE_ERROR, the rest of the body is ignored
+      break;
     }
   }
+  // the segment is handed back to the stack after this, so nothing may point into it
+  _multipartItemData(tail, tailLength);
 }
 
 void AsyncWebServerRequest::_parseLine(){
@@ -569,17 +974,28 @@ void AsyncWebServerRequest::_parseLine(){
       _server->_rewriteRequest(this);
       _server->_attachHandler(this);
       _removeNotInterestingHeaders();
+      if(_isChunked){
+        // the length only becomes known once the last chunk arrived
+        _contentLength = 0;
+        _chunkState = CHUNK_SIZE_START;
+        _chunkRemaining = 0;
+      }
+#if ASYNCWEBSERVER_MAX_BODY_SIZE > 0
+      if(_contentLength > ASYNCWEBSERVER_MAX_BODY_SIZE){
+        _parseState = PARSE_REQ_BODY;
+        _bodyError(413);
+        return;
+      }
+#endif
       if(_expectingContinue){
         const char * response = "HTTP/1.1 100 Continue\r\n\r\n";
         _client->write(response, os_strlen(response));
       }
       //check handler for authentication
-      if(_contentLength){
+      if(_contentLength || _isChunked){
         _parseState = PARSE_REQ_BODY;
       } else {
-        _parseState = PARSE_REQ_END;
-        if(_handler) _handler->handleRequest(this);
-        else send(501);
+        _bodyEnd();
       }
     } else _parseReqHeader();
   }
@@ -647,16 +1063,12 @@ AsyncWebHeader* AsyncWebServerRequest::getHeader(size_t num) const {
 }
 
 size_t AsyncWebServerRequest::params() const {
-  return _params.length();
+  _decodeParams();
+  return _paramCount;
 }
 
 bool AsyncWebServerRequest::hasParam(const String& name, bool post, bool file) const {
-  for(const auto& p: _params){
-    if(p->name() == name && p->isPost() == post && p->isFile() == file){
-      return true;
-    }
-  }
-  return false;
+  return _findParam(name.c_str(), name.length(), false, post, file) != nullptr;
 }
 
 bool AsyncWebServerRequest::hasParam(const __FlashStringHelper * data, bool post, bool file) const {
@@ -676,12 +1088,7 @@ bool AsyncWebServerRequest::hasParam(const __FlashStringHelper * data, bool post
 }
 
 AsyncWebParameter* AsyncWebServerRequest::getParam(const String& name, bool post, bool file) const {
-  for(const auto& p: _params){
-    if(p->name() == name && p->isPost() == post && p->isFile() == file){
-      return p;
-    }
-  }
-  return nullptr;
+  return _findParam(name.c_str(), name.length(), false, post, file);
 }
 
 AsyncWebParameter* AsyncWebServerRequest::getParam(const __FlashStringHelper * data, bool post, bool file) const {
@@ -699,8 +1106,8 @@ AsyncWebParameter* AsyncWebServerRequest::getParam(const __FlashStringHelper * d
 }
 
 AsyncWebParameter* AsyncWebServerRequest::getParam(size_t num) const {
-  auto param = _params.nth(num);
-  return param ? *param : nullptr;
+  _decodeParams();
+  return num < _paramCount ? _params[num] : nullptr;
 }
 
 void AsyncWebServerRequest::addInterestingHeader(const String& name){
@@ -730,6 +1137,10 @@ AsyncWebServerResponse * AsyncWebServerRequest::beginResponse(int code, const St
   return new AsyncBasicResponse(code, contentType, content);
 }
 
+AsyncWebServerResponse * AsyncWebServerRequest::beginResponse(int code, const String& contentType, AsyncWebSharedBuffer* content){
+  return new AsyncBasicResponse(code, contentType, content);
+}
+
 AsyncWebServerResponse * AsyncWebServerRequest::beginResponse(FS &fs, const String& path, const String& contentType, bool download, AwsTemplateProcessor callback){
   if(fs.exists(path) || (!download && fs.exists(path+".gz")))
     return new AsyncFileResponse(fs, path, contentType, download, callback);
@@ -772,6 +1183,18 @@ void AsyncWebServerRequest::send(int code, const String& contentType, const Stri
   send(beginResponse(code, contentType, content));
 }
 
+void AsyncWebServerRequest::send(int code, const String& contentType, AsyncWebSharedBuffer* content){
+  send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::send(int code, const String& contentType, const AsyncWebSharedBody& content){
+  AsyncWebSharedBuffer* buffer = content.acquire();
+  if(buffer == NULL) // nothing published yet
+    return send(code, contentType, String());
+  send(beginResponse(code, contentType, buffer));
+  buffer->release();
+}
+
 void AsyncWebServerRequest::send(FS &fs, const String& path, const String& contentType, bool download, AwsTemplateProcessor callback){
   if(fs.exists(path) || (!download && fs.exists(path+".gz"))){
     send(beginResponse(fs, path, contentType, download, callback));
@@ -862,12 +1285,7 @@ void AsyncWebServerRequest::requestAuthentication(const char * realm, bool isDig
 }
 
 bool AsyncWebServerRequest::hasArg(const char* name) const {
-  for(const auto& arg: _params){
-    if(arg->name() == name){
-      return true;
-    }
-  }
-  return false;
+  return _findParam(name, strlen(name), true, false, false) != nullptr;
 }
 
 bool AsyncWebServerRequest::hasArg(const __FlashStringHelper * data) const {
@@ -886,12 +1304,8 @@ bool AsyncWebServerRequest::hasArg(const __FlashStringHelper * data) const {
 
 
 const String& AsyncWebServerRequest::arg(const String& name) const {
-  for(const auto& arg: _params){
-    if(arg->name() == name){
-      return arg->value();
-    }
-  }
-  return SharedEmptyString;
+  AsyncWebParameter* p = _findParam(name.c_str(), name.length(), true, false, false);
+  return p ? p->value() : SharedEmptyString;
 }
 
 const String& AsyncWebServerRequest::arg(const __FlashStringHelper * data) const {
@@ -918,8 +1332,33 @@ const String& AsyncWebServerRequest::argName(size_t i) const {
 }
 
 const String& AsyncWebServerRequest::pathArg(size_t i) const {
-  auto param = _pathParams.nth(i);
-  return param ? **param : SharedEmptyString;
+  if(i >= _pathArgs.count)
+    return SharedEmptyString;
+  // the String copies are only made once a handler asks for them
+  AsyncWebServerRequest* self = const_cast<AsyncWebServerRequest*>(this);
+  while(_pathParams.length() <= i){
+    size_t n = _pathParams.length();
+    String* param = self->_arena.create<String>(_url.substring(_pathArgs.start[n], _pathArgs.start[n] + _pathArgs.len[n]));
+    if(param == NULL)
+      return SharedEmptyString;
+    self->_pathParams.add(param);
+    if(_pathParams.length() == n){
+      AsyncWebArena::destroy(param);
+      return SharedEmptyString;
+    }
+  }
+  return **_pathParams.nth(i);
+}
+
+const char* AsyncWebServerRequest::pathArg(size_t i, size_t* len) const {
+  if(i >= _pathArgs.count){
+    if(len)
+      *len = 0;
+    return "";
+  }
+  if(len)
+    *len = _pathArgs.len[i];
+  return _url.c_str() + _pathArgs.start[i];
 }
 
 const String& AsyncWebServerRequest::header(const char* name) const {
@@ -952,6 +1391,82 @@ const String& AsyncWebServerRequest::headerName(size_t i) const {
   return h ? h->name() : SharedEmptyString;
 }
 
+uint16_t AsyncWebServerRequest::acceptsEncoding(const char* coding) const {
+  // RFC 7231, 5.3.4: a listed coding has its own q, anything else the one of "*",
+  // identity stays acceptable unless it is excluded
+  bool gzip = !strcasecmp(coding, "gzip");
+  int codingQ = -1;
+  int starQ = -1;
+  const char* p = hasHeader("Accept-Encoding") ? header("Accept-Encoding").c_str() : "";
+  while(*p){
+    while(*p == ' ' || *p == ',')
+      p++;
+    const char* name = p;
+    while(*p && *p != ',' && *p != ';' && *p != ' ')
+      p++;
+    size_t nameLen = p - name;
+    int q = 1000;
+    while(*p && *p != ','){
+      if((p[0] == 'q' || p[0] == 'Q') && p[1] == '='){
+        p += 2;
+        q = (*p == '1') ? 1000 : 0;
+        if(*p == '0' || *p == '1')
+          p++;
+        if(*p == '.'){
+          p++;
+          for(int scale = 100; *p >= '0' && *p <= '9'; p++, scale /= 10)
+            q += (*p - '0') * scale;
+        }
+        if(q > 1000)
+          q = 1000;
+        continue;
+      }
+      p++;
+    }
+    if(nameLen == 1 && name[0] == '*')
+      starQ = q;
+    else if((nameLen == strlen(coding) && !strncasecmp(name, coding, nameLen)) || (gzip && nameLen == 6 && !strncasecmp(name, "x-gzip", 6)))
+      codingQ = q;
+  }
+  if(codingQ >= 0)
+    return codingQ;
+  if(starQ >= 0)
+    return starQ;
+  return strcasecmp(coding, "identity") ? 0 : 1000;
+}
+
+bool AsyncWebServerRequest::acceptsGzip() const {
+  return acceptsEncoding("gzip") > 0;
+}
+
+bool AsyncWebServerRequest::etagMatches(const char* etag) const {
+  if(!hasHeader("If-None-Match"))
+    return false;
+  const String& header = this->header("If-None-Match");
+  if(header == "*")
+    return true;
+  if(etag[0] == 'W' && etag[1] == '/')
+    etag += 2;
+  size_t etagLen = strlen(etag);
+  const char* p = header.c_str();
+  while(*p){
+    while(*p == ' ' || *p == ',')
+      p++;
+    if(p[0] == 'W' && p[1] == '/')
+      p += 2;
+    const char* end = p;
+    while(*end && *end != ',')
+      end++;
+    const char* last = end;
+    while(last > p && last[-1] == ' ')
+      last--;
+    if((size_t)(last - p) == etagLen && !memcmp(p, etag, etagLen))
+      return true;
+    p = end;
+  }
+  return false;
+}
+
 String AsyncWebServerRequest::urlDecode(const String& text) const {
   char temp[] = "0x00";
   unsigned int len = text.length();
@@ -27,13 +27,24 @@
 #undef max
 #endif
 #include <vector>
+#include "AsyncWebDeflate.h"
+#include "AsyncWebFileStream.h"
 // It is possible to restore these defines, but one can use _min and _max instead. Or std::min, std::max.
 
 class AsyncBasicResponse: public AsyncWebServerResponse {
   private:
     String _content;
+    AsyncWebSharedBuffer* _shared; // sent instead of _content when set
+    const uint8_t* _static; // the same, never freed (flash), lent to lwIP without copying
+    const char* _head; // serialized into the request arena by _respond()
+    void _compress(AsyncWebServerRequest *request);
+    size_t _headSent;
+    size_t _send(AsyncWebServerRequest *request);
   public:
     AsyncBasicResponse(int code, const String& contentType=String(), const String& content=String());
+    AsyncBasicResponse(int code, const String& contentType, AsyncWebSharedBuffer* content);
+    AsyncBasicResponse(int code, const String& contentType, const uint8_t* content, size_t len);
+    ~AsyncBasicResponse();
     void _respond(AsyncWebServerRequest *request);
     size_t _ack(AsyncWebServerRequest *request, size_t len, uint32_t time);
     bool _sourceValid() const { return true; }
@@ -42,17 +53,30 @@ class AsyncBasicResponse: public AsyncWebServerResponse {
 class AsyncAbstractResponse: public AsyncWebServerResponse {
   private:
     String _head;
-    // Data is inserted into cache at begin(). 
-    // This is inefficient with vector, but if we use some other container, 
-    // we won't be able to access it as contiguous array of bytes when reading from it,
-    // so by gaining performance in one place, we'll lose it in another.
+    // Data is put back in front of what is left and read from _cacheOffset on, the vector is
+    // only emptied once everything was read, so reading never moves the remaining bytes
     std::vector<uint8_t> _cache;
+    size_t _cacheOffset;
+    void _cachePrepend(const uint8_t* first, const uint8_t* last);
     size_t _readDataFromCacheOrContent(uint8_t* data, const size_t len);
     size_t _fillBufferAndProcessTemplates(uint8_t* buf, size_t maxLen);
+    // Rendering of a compiled template: one value per distinct placeholder, resolved in _respond()
+    String* _templateValues;
+    size_t _templateSegment;
+    size_t _templateOffset;
+    void _resolveTemplate();
+    size_t _renderTemplate(uint8_t* data, size_t len);
+    // Output of setGzip(true): the content is pulled through _deflate and sent chunked
+    AsyncWebDeflate* _deflate;
+    size_t _rawLength; // content to compress, SIZE_MAX when it ends with an empty fill
+    size_t _rawRead;
+    size_t _fillCompressed(uint8_t* data, size_t len);
   protected:
     AwsTemplateProcessor _callback;
+    AsyncWebTemplate* _template; // set by sources that can be compiled, _callback fills in the values
   public:
     AsyncAbstractResponse(AwsTemplateProcessor callback=nullptr);
+    ~AsyncAbstractResponse();
     void _respond(AsyncWebServerRequest *request);
     size_t _ack(AsyncWebServerRequest *request, size_t len, uint32_t time);
     bool _sourceValid() const { return false; }
@@ -64,18 +88,51 @@ class AsyncAbstractResponse: public AsyncWebServerResponse {
 #endif
 
 #define TEMPLATE_PARAM_NAME_LENGTH 32
+
+// Content below this many bytes is sent as it is even with setGzip(true), the gzip framing alone is 18 bytes
+#ifndef ASYNCWEBSERVER_GZIP_THRESHOLD
+#define ASYNCWEBSERVER_GZIP_THRESHOLD 512
+#endif
+
+// Ranges one file response sends as multipart/byteranges, requests for more get the whole file
+#ifndef ASYNCWEBSERVER_MAX_RANGES
+#define ASYNCWEBSERVER_MAX_RANGES 8
+#endif
+
+struct AsyncFileRange {
+  size_t start;
+  size_t end; // one past the last byte
+};
+
 class AsyncFileResponse: public AsyncAbstractResponse {
   using File = fs::File;
   using FS = fs::FS;
   private:
     File _content;
+    AsyncWebFileStream* _stream; // _content read ahead by the reader task, _content is closed then
     String _path;
+    // multipart/byteranges state, used with more than one range only
+    AsyncFileRange* _ranges; // in the request arena
+    uint8_t _rangeCount;
+    uint8_t _part;           // _rangeCount is the closing delimiter
+    size_t _partPos;
+    String _partHead;
+    String _partType;
+    char _boundary[17];
     void _setContentType(const String& path);
+    void _compileTemplate(const String& key);
+    void _applyRange(AsyncWebServerRequest *request);
+    bool _ifRangeMatches(const String& value);
+    String _partHeader(size_t part);
+    size_t _fillParts(uint8_t *data, size_t len);
+    void _openStream(AsyncWebServerRequest *request);
   public:
+    static const char* contentTypeFor(const String& path);
     AsyncFileResponse(FS &fs, const String& path, const String& contentType=String(), bool download=false, AwsTemplateProcessor callback=nullptr);
     AsyncFileResponse(File content, const String& path, const String& contentType=String(), bool download=false, AwsTemplateProcessor callback=nullptr);
     ~AsyncFileResponse();
-    bool _sourceValid() const { return !!(_content); }
+    bool _sourceValid() const { return !!(_content) || _template || _stream; }
+    void _respond(AsyncWebServerRequest *request);
     virtual size_t _fillBuffer(uint8_t *buf, size_t maxLen) override;
 };
 
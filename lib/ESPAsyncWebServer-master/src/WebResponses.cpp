@@ -89,16 +89,15 @@ AsyncWebServerResponse::AsyncWebServerResponse()
   , _contentLength(0)
   , _sendContentLength(true)
   , _chunked(false)
+  , _closeConnection(false)
+  , _acceptRanges(false)
+  , _gzip(false)
   , _headLength(0)
   , _sentLength(0)
   , _ackedLength(0)
   , _writtenLength(0)
   , _state(RESPONSE_SETUP)
-{
-  for(auto header: DefaultHeaders::Instance()) {
-    _headers.add(new AsyncWebHeader(header->name(), header->value()));
-  }
-}
+{}
 
 AsyncWebServerResponse::~AsyncWebServerResponse(){
   _headers.free();
@@ -123,39 +122,124 @@ void AsyncWebServerResponse::addHeader(const String& name, const String& value){
   _headers.add(new AsyncWebHeader(name, value));
 }
 
-String AsyncWebServerResponse::_assembleHead(uint8_t version){
+static const char HEAD_CONTENT_LENGTH[] = "Content-Length: ";
+static const char HEAD_CONTENT_TYPE[] = "Content-Type: ";
+static const char HEAD_CONNECTION_CLOSE[] = "Connection: close\r\n";
+static const char HEAD_ACCEPT_RANGES[] = "Accept-Ranges: none\r\n";
+static const char HEAD_ACCEPT_RANGES_BYTES[] = "Accept-Ranges: bytes\r\n";
+static const char HEAD_CHUNKED[] = "Transfer-Encoding: chunked\r\n";
+
+// snprintf("%u") without the format parsing, returns the number of characters written
+static size_t formatDecimal(char* out, size_t value){
+  char tmp[20];
+  size_t n = 0;
+  do {
+    tmp[n++] = '0' + value % 10;
+    value /= 10;
+  } while(value);
+  for(size_t i = 0; i < n; i++)
+    out[i] = tmp[n - 1 - i];
+  return n;
+}
+
+/*
+ * Serializes the head into out and returns its length. With out == NULL only the length is
+ * returned and nothing changes, so the caller can size the buffer first.
+ * */
+size_t AsyncWebServerResponse::_writeHead(uint8_t version, char* out){
+  size_t n = 0;
+  auto put = [&](const char* data, size_t len){
+    if(out)
+      memcpy(out + n, data, len);
+    n += len;
+  };
+  char num[20];
+
+  put("HTTP/1.", 7);
+  num[0] = '0' + version;
+  num[1] = ' ';
+  put(num, 2);
+  put(num, formatDecimal(num, _code));
+  put(" ", 1);
+  const char* reason = _responseCodeToString(_code);
+  put(reason, strlen(reason));
+  put("\r\n", 2);
+
+  if(_sendContentLength){
+    put(HEAD_CONTENT_LENGTH, sizeof(HEAD_CONTENT_LENGTH) - 1);
+    put(num, formatDecimal(num, _contentLength));
+    put("\r\n", 2);
+  }
+  if(_contentType.length()){
+    put(HEAD_CONTENT_TYPE, sizeof(HEAD_CONTENT_TYPE) - 1);
+    put(_contentType.c_str(), _contentType.length());
+    put("\r\n", 2);
+  }
+
+  const String& defaults = DefaultHeaders::Instance().block();
+  put(defaults.c_str(), defaults.length());
+  if(_closeConnection)
+    put(HEAD_CONNECTION_CLOSE, sizeof(HEAD_CONNECTION_CLOSE) - 1);
+  for(const auto& header: _headers){
+    put(header->name().c_str(), header->name().length());
+    put(": ", 2);
+    put(header->value().c_str(), header->value().length());
+    put("\r\n", 2);
+  }
   if(version){
-    addHeader("Accept-Ranges","none");
+    if(_acceptRanges)
+      put(HEAD_ACCEPT_RANGES_BYTES, sizeof(HEAD_ACCEPT_RANGES_BYTES) - 1);
+    else
+      put(HEAD_ACCEPT_RANGES, sizeof(HEAD_ACCEPT_RANGES) - 1);
     if(_chunked)
-      addHeader("Transfer-Encoding","chunked");
+      put(HEAD_CHUNKED, sizeof(HEAD_CHUNKED) - 1);
   }
-  String out = String();
-  int bufSize = 300;
-  char buf[bufSize];
+  put("\r\n", 2);
 
-  snprintf(buf, bufSize, "HTTP/1.%d %d %s\r\n", version, _code, _responseCodeToString(_code));
-  out.concat(buf);
-
-  if(_sendContentLength) {
-    snprintf(buf, bufSize, "Content-Length: %d\r\n", _contentLength);
-    out.concat(buf);
-  }
-  if(_contentType.length()) {
-    snprintf(buf, bufSize, "Content-Type: %s\r\n", _contentType.c_str());
-    out.concat(buf);
+  if(out){
+    _headers.free();
+    _headLength = n;
   }
+  return n;
+}
 
+/*
+ * Whether setGzip(true) content is compressed for this request: only complete 200 responses
+ * that carry no Content-Encoding of their own. The answer depends on Accept-Encoding either
+ * way, which caches are told with Vary.
+ * */
+bool AsyncWebServerResponse::_gzipFor(AsyncWebServerRequest *request){
+  if(!_gzip || _code != 200)
+    return false;
   for(const auto& header: _headers){
-    snprintf(buf, bufSize, "%s: %s\r\n", header->name().c_str(), header->value().c_str());
-    out.concat(buf);
+    if(header->name().equalsIgnoreCase("Content-Encoding"))
+      return false;
   }
-  _headers.free();
+  addHeader("Vary", "Accept-Encoding");
+  return request->acceptsGzip();
+}
 
-  out.concat("\r\n");
-  _headLength = out.length();
+String AsyncWebServerResponse::_assembleHead(uint8_t version){
+  size_t len = _headSize(version);
+  char* buf = (char*)malloc(len + 1);
+  if(buf == NULL)
+    return String();
+  _writeHead(version, buf);
+  buf[len] = 0;
+  String out = String(buf);
+  free(buf);
   return out;
 }
 
+size_t AsyncWebServerResponse::_sendHead(AsyncWebServerRequest *request){
+  size_t len = _headSize(request->version());
+  char* buf = (char*)request->arena().alloc(len, 1);
+  if(buf == NULL)
+    return 0;
+  _writeHead(request->version(), buf);
+  return request->client()->write(buf, len);
+}
+
 bool AsyncWebServerResponse::_started() const { return _state > RESPONSE_SETUP; }
 bool AsyncWebServerResponse::_finished() const { return _state > RESPONSE_WAIT_ACK; }
 bool AsyncWebServerResponse::_failed() const { return _state == RESPONSE_FAILED; }
@@ -166,7 +250,12 @@ size_t AsyncWebServerResponse::_ack(AsyncWebServerRequest *request, size_t len,
 /*
  * String/Code Response
  * */
-AsyncBasicResponse::AsyncBasicResponse(int code, const String& contentType, const String& content){
+AsyncBasicResponse::AsyncBasicResponse(int code, const String& contentType, const String& content)
+  : _shared(NULL)
+  , _static(NULL)
+  , _head(NULL)
+  , _headSent(0)
+{
   _code = code;
   _content = content;
   _contentType = contentType;
@@ -175,62 +264,126 @@ AsyncBasicResponse::AsyncBasicResponse(int code, const String& contentType, cons
     if(!_contentType.length())
       _contentType = "text/plain";
   }
-  addHeader("Connection","close");
+  _closeConnection = true;
+}
+
+AsyncBasicResponse::AsyncBasicResponse(int code, const String& contentType, AsyncWebSharedBuffer* content)
+  : _shared(content ? content->retain() : NULL)
+  , _static(NULL)
+  , _head(NULL)
+  , _headSent(0)
+{
+  _code = code;
+  _contentType = contentType;
+  if(_shared && _shared->length()){
+    _contentLength = _shared->length();
+    if(!_contentType.length())
+      _contentType = "text/plain";
+  }
+  _closeConnection = true;
+}
+
+AsyncBasicResponse::AsyncBasicResponse(int code, const String& contentType, const uint8_t* content, size_t len)
+  : _shared(NULL)
+  , _static(content)
+  , _head(NULL)
+  , _headSent(0)
+{
+  _code = code;
+  _contentType = contentType;
+  _contentLength = len;
+  if(len && !_contentType.length())
+    _contentType = "text/plain";
+  _closeConnection = true;
+}
+
+AsyncBasicResponse::~AsyncBasicResponse(){
+  if(_shared)
+    _shared->release();
+}
+
+/*
+ * The content is in memory already, so it is compressed in one go into a buffer of its own
+ * size and the exact Content-Length stays. Content that does not get smaller is sent as it is.
+ * */
+void AsyncBasicResponse::_compress(AsyncWebServerRequest *request){
+  if(!_gzipFor(request) || _contentLength < ASYNCWEBSERVER_GZIP_THRESHOLD)
+    return;
+  const uint8_t* content = _static ? _static : _shared ? _shared->data() : (const uint8_t*)_content.c_str();
+  size_t available = _static ? _contentLength : _shared ? _shared->length() : _content.length();
+  size_t len = (available < _contentLength)?available:_contentLength;
+  AsyncWebSharedBuffer* compressed = AsyncWebSharedBuffer::create(NULL, len);
+  if(compressed == NULL)
+    return;
+  size_t compressedLen = AsyncWebDeflate::gzip(content, len, compressed->data(), len);
+  if(!compressedLen){
+    compressed->release();
+    return;
+  }
+  if(_shared)
+    _shared->release();
+  _shared = compressed;
+  _static = NULL;
+  _content = String();
+  _contentLength = compressedLen;
+  addHeader("Content-Encoding", "gzip");
 }
 
 void AsyncBasicResponse::_respond(AsyncWebServerRequest *request){
-  _state = RESPONSE_HEADERS;
-  String out = _assembleHead(request->version());
-  size_t outLen = out.length();
-  size_t space = request->client()->space();
-  if(!_contentLength && space >= outLen){
-    _writtenLength += request->client()->write(out.c_str(), outLen);
-    _state = RESPONSE_WAIT_ACK;
-  } else if(_contentLength && space >= outLen + _contentLength){
-    out += _content;
-    outLen += _contentLength;
-    _writtenLength += request->client()->write(out.c_str(), outLen);
-    _state = RESPONSE_WAIT_ACK;
-  } else if(space && space < outLen){
-    String partial = out.substring(0, space);
-    _content = out.substring(space) + _content;
-    _contentLength += outLen - space;
-    _writtenLength += request->client()->write(partial.c_str(), partial.length());
-    _state = RESPONSE_CONTENT;
-  } else if(space > outLen && space < (outLen + _contentLength)){
-    size_t shift = space - outLen;
-    outLen += shift;
-    _sentLength += shift;
-    out += _content.substring(0, shift);
-    _content = _content.substring(shift);
-    _writtenLength += request->client()->write(out.c_str(), outLen);
-    _state = RESPONSE_CONTENT;
-  } else {
-    _content = out + _content;
-    _contentLength += outLen;
-    _state = RESPONSE_CONTENT;
+  _compress(request);
+  size_t headLen = _headSize(request->version());
+  char* head = (char*)request->arena().alloc(headLen, 1);
+  if(head == NULL){
+    _state = RESPONSE_FAILED;
+    request->client()->close(true);
+    return;
   }
+  _writeHead(request->version(), head);
+  _head = head;
+  _state = RESPONSE_CONTENT;
+  _send(request);
+}
+
+/*
+ * Head and content are never modified once the response started, cursors into them
+ * track what was sent and every packet is added straight from there.
+ * */
+size_t AsyncBasicResponse::_send(AsyncWebServerRequest *request){
+  AsyncClient* client = request->client();
+  size_t space = client->space();
+  const char* content = _static ? (const char*)_static : _shared ? (const char*)_shared->data() : _content.c_str();
+  size_t available = _static ? _contentLength : _shared ? _shared->length() : _content.length();
+  size_t contentLen = (available < _contentLength)?available:_contentLength;
+  size_t written = 0;
+
+  if(_headSent < _headLength && space){
+    size_t n = ((_headLength - _headSent) > space)?space:(_headLength - _headSent);
+    n = client->add(_head + _headSent, n);
+    _headSent += n;
+    written += n;
+    space -= n;
+  }
+  if(_headSent == _headLength && _sentLength < contentLen && space){
+    size_t n = ((contentLen - _sentLength) > space)?space:(contentLen - _sentLength);
+    n = client->add(content + _sentLength, n, _static ? 0 : ASYNC_WRITE_FLAG_COPY);
+    _sentLength += n;
+    written += n;
+  }
+
+  if(written){
+    client->send();
+    _writtenLength += written;
+  }
+  if(_headSent == _headLength && _sentLength == contentLen)
+    _state = RESPONSE_WAIT_ACK;
+  return written;
 }
 
 size_t AsyncBasicResponse::_ack(AsyncWebServerRequest *request, size_t len, uint32_t time){
   (void)time;
   _ackedLength += len;
   if(_state == RESPONSE_CONTENT){
-    size_t available = _contentLength - _sentLength;
-    size_t space = request->client()->space();
-    //we can fit in this packet
-    if(space > available){
-      _writtenLength += request->client()->write(_content.c_str(), available);
-      _content = String();
-      _state = RESPONSE_WAIT_ACK;
-      return available;
-    }
-    //send some data, the rest on ack
-    String out = _content.substring(0, space);
-    _content = _content.substring(space);
-    _sentLength += space;
-    _writtenLength += request->client()->write(out.c_str(), space);
-    return space;
+    return _send(request);
   } else if(_state == RESPONSE_WAIT_ACK){
     if(_ackedLength >= _writtenLength){
       _state = RESPONSE_END;
@@ -239,12 +392,20 @@ size_t AsyncBasicResponse::_ack(AsyncWebServerRequest *request, size_t len, uint
   return 0;
 }
 
-
 /*
  * Abstract Response
  * */
 
-AsyncAbstractResponse::AsyncAbstractResponse(AwsTemplateProcessor callback): _callback(callback)
+AsyncAbstractResponse::AsyncAbstractResponse(AwsTemplateProcessor callback)
+  : _cacheOffset(0)
+  , _templateValues(NULL)
+  , _templateSegment(0)
+  , _templateOffset(0)
+  , _deflate(NULL)
+  , _rawLength(0)
+  , _rawRead(0)
+  , _callback(callback)
+  , _template(NULL)
 {
   // In case of template processing, we're unable to determine real response size
   if(callback) {
@@ -254,9 +415,32 @@ AsyncAbstractResponse::AsyncAbstractResponse(AwsTemplateProcessor callback): _ca
   }
 }
 
+AsyncAbstractResponse::~AsyncAbstractResponse(){
+  delete[] _templateValues;
+  if(_template)
+    _template->release();
+  delete _deflate;
+}
+
 void AsyncAbstractResponse::_respond(AsyncWebServerRequest *request){
-  addHeader("Connection","close");
-  _head = _assembleHead(request->version());
+  if(_template && _callback)
+    _resolveTemplate();
+  if(_gzipFor(request) && request->version()
+    && (!_sendContentLength || _contentLength >= ASYNCWEBSERVER_GZIP_THRESHOLD)){
+    // the compressed length is only known at the end, so the body goes out chunked
+    _deflate = new AsyncWebDeflate();
+    if(_deflate->begin()){
+      addHeader("Content-Encoding", "gzip");
+      _rawLength = _sendContentLength ? _contentLength : SIZE_MAX;
+      _sendContentLength = false;
+      _chunked = true;
+    } else {
+      delete _deflate;
+      _deflate = NULL;
+    }
+  }
+  _closeConnection = true;
+  _headLength = _headSize(request->version());
   _state = RESPONSE_HEADERS;
   _ack(request, 0, 0);
 }
@@ -270,21 +454,33 @@ size_t AsyncAbstractResponse::_ack(AsyncWebServerRequest *request, size_t len, u
   }
   _ackedLength += len;
   size_t space = request->client()->space();
+  AsyncWebPool* pool = AsyncWebServer::_txBuffers();
+  if(pool && space > ASYNCWEBSERVER_TX_BUFFER_SIZE)
+    space = ASYNCWEBSERVER_TX_BUFFER_SIZE;
 
-  size_t headLen = _head.length();
+  // head bytes that go out in front of the content of this packet
+  size_t headLen = 0;
   if(_state == RESPONSE_HEADERS){
-    if(space >= headLen){
-      _state = RESPONSE_CONTENT;
+    size_t pending = _head.length() ? _head.length() : _headLength;
+    // a chunked body needs room for at least one chunk header behind the head
+    if(space >= pending + (_chunked ? 9 : 0)){
+      // the state moves on once the head has actually been written
+      headLen = pending;
       space -= headLen;
     } else {
+      // the head does not fit, it is sent piece by piece from a copy
+      if(!_head.length())
+        _head = _assembleHead(request->version());
       String out = _head.substring(0, space);
       _head = _head.substring(space);
+      if(!_head.length())
+        _state = RESPONSE_CONTENT;
       _writtenLength += request->client()->write(out.c_str(), out.length());
       return out.length();
     }
   }
 
-  if(_state == RESPONSE_CONTENT){
+  if(_state == RESPONSE_CONTENT || headLen){
     size_t outLen;
     if(_chunked){
       if(space <= 8){
@@ -297,14 +493,16 @@ size_t AsyncAbstractResponse::_ack(AsyncWebServerRequest *request, size_t len, u
       outLen = ((_contentLength - _sentLength) > space)?space:(_contentLength - _sentLength);
     }
 
-    uint8_t *buf = (uint8_t *)malloc(outLen+headLen);
-    if (!buf) {
-      // os_printf("_ack malloc %d failed\n", outLen+headLen);
-      return 0;
-    }
-
-    if(headLen){
-      memcpy(buf, _head.c_str(), _head.length());
+    // a pooled buffer is only held until write() has copied it, the heap is the fallback
+    uint8_t *buf = pool ? (uint8_t *)pool->take() : NULL;
+    if(pool && !buf)
+      AsyncWebServer::_txBufferMiss();
+    if(!buf){
+      buf = (uint8_t *)malloc(outLen+headLen);
+      if (!buf) {
+        // os_printf("_ack malloc %d failed\n", outLen+headLen);
+        return 0;
+      }
     }
 
     size_t readLen = 0;
@@ -312,9 +510,10 @@ size_t AsyncAbstractResponse::_ack(AsyncWebServerRequest *request, size_t len, u
     if(_chunked){
       // HTTP 1.1 allows leading zeros in chunk length. Or spaces may be added.
       // See RFC2616 sections 2, 3.6.1.
-      readLen = _fillBufferAndProcessTemplates(buf+headLen+6, outLen - 8);
+      readLen = _deflate ? _fillCompressed(buf+headLen+6, outLen - 8) : _fillBufferAndProcessTemplates(buf+headLen+6, outLen - 8);
       if(readLen == RESPONSE_TRY_AGAIN){
-          free(buf);
+          if(!pool || !pool->give(buf))
+            free(buf);
           return 0;
       }
       outLen = sprintf((char*)buf+headLen, "%x", readLen) + headLen;
@@ -327,14 +526,21 @@ size_t AsyncAbstractResponse::_ack(AsyncWebServerRequest *request, size_t len, u
     } else {
       readLen = _fillBufferAndProcessTemplates(buf+headLen, outLen);
       if(readLen == RESPONSE_TRY_AGAIN){
-          free(buf);
+          if(!pool || !pool->give(buf))
+            free(buf);
           return 0;
       }
       outLen = readLen + headLen;
     }
 
     if(headLen){
-        _head = String();
+      // written last, a failed fill above leaves the head pending for the next ack
+      if(_head.length())
+        memcpy(buf, _head.c_str(), headLen);
+      else
+        _writeHead(request->version(), (char*)buf);
+      _head = String();
+      _state = RESPONSE_CONTENT;
     }
 
     if(outLen){
@@ -347,7 +553,8 @@ size_t AsyncAbstractResponse::_ack(AsyncWebServerRequest *request, size_t len, u
         _sentLength += outLen - headLen;
     }
 
-    free(buf);
+    if(!pool || !pool->give(buf))
+      free(buf);
 
     if((_chunked && readLen == 0) || (!_sendContentLength && outLen == 0) || (!_chunked && _sentLength == _contentLength)){
       _state = RESPONSE_WAIT_ACK;
@@ -364,13 +571,31 @@ size_t AsyncAbstractResponse::_ack(AsyncWebServerRequest *request, size_t len, u
   return 0;
 }
 
+void AsyncAbstractResponse::_cachePrepend(const uint8_t* first, const uint8_t* last)
+{
+    const size_t n = last - first;
+    if(n == 0)
+      return;
+    if(n <= _cacheOffset) {
+      // fits into what was read already
+      _cacheOffset -= n;
+      memcpy(_cache.data() + _cacheOffset, first, n);
+    } else {
+      _cache.insert(_cache.begin() + _cacheOffset, first, last);
+    }
+}
+
 size_t AsyncAbstractResponse::_readDataFromCacheOrContent(uint8_t* data, const size_t len)
 {
     // If we have something in cache, copy it to buffer
-    const size_t readFromCache = std::min(len, _cache.size());
+    const size_t readFromCache = std::min(len, _cache.size() - _cacheOffset);
     if(readFromCache) {
-      memcpy(data, _cache.data(), readFromCache);
-      _cache.erase(_cache.begin(), _cache.begin() + readFromCache);
+      memcpy(data, _cache.data() + _cacheOffset, readFromCache);
+      _cacheOffset += readFromCache;
+      if(_cacheOffset == _cache.size()) {
+        _cache.clear();
+        _cacheOffset = 0;
+      }
     }
     // If we need to read more...
     const size_t needFromFile = len - readFromCache;
@@ -378,8 +603,82 @@ size_t AsyncAbstractResponse::_readDataFromCacheOrContent(uint8_t* data, const s
     return readFromCache + readFromContent;
 }
 
+/*
+ * Raw content is pulled into the deflater whenever it runs out of output. Returns 0 only
+ * once the whole gzip stream was read, the raw content ends at _rawLength or at an empty fill.
+ * */
+size_t AsyncAbstractResponse::_fillCompressed(uint8_t* data, size_t len){
+  size_t outLen = 0;
+  while(outLen < len && !_deflate->done()){
+    size_t n = _deflate->read(data + outLen, len - outLen);
+    outLen += n;
+    if(n)
+      continue;
+    size_t space;
+    uint8_t* in = _deflate->input(&space);
+    if(space > _rawLength - _rawRead)
+      space = _rawLength - _rawRead;
+    size_t readLen = space ? _fillBufferAndProcessTemplates(in, space) : 0;
+    if(readLen == RESPONSE_TRY_AGAIN)
+      break;
+    _deflate->commit(readLen);
+    _rawRead += readLen;
+    if(!readLen)
+      _deflate->finish();
+  }
+  return (outLen || _deflate->done()) ? outLen : RESPONSE_TRY_AGAIN;
+}
+
+/*
+ * With all values known up front the exact length is known as well, compiled
+ * templates go out with a Content-Length instead of chunked.
+ * */
+void AsyncAbstractResponse::_resolveTemplate(){
+  if(_template->nameCount())
+    _templateValues = new String[_template->nameCount()];
+  for(size_t i = 0; i < _template->nameCount(); i++)
+    _templateValues[i] = _callback(_template->name(i));
+
+  _contentLength = _template->render(_templateValues, NULL);
+  _sendContentLength = true;
+  _chunked = false;
+}
+
+// Copies the next literal and value slices, _templateOffset runs over a segment's literal and then its value
+size_t AsyncAbstractResponse::_renderTemplate(uint8_t* data, size_t len){
+  size_t outLen = 0;
+  while(outLen < len && _templateSegment < _template->segmentCount()){
+    const AsyncWebTemplate::Segment& segment = _template->segment(_templateSegment);
+    const uint8_t* src;
+    size_t available;
+    if(_templateOffset < segment.length){
+      src = _template->text() + segment.offset + _templateOffset;
+      available = segment.length - _templateOffset;
+    } else if(segment.name >= 0 && _templateValues){
+      const String& value = _templateValues[segment.name];
+      size_t valueOffset = _templateOffset - segment.length;
+      src = (const uint8_t*)value.c_str() + valueOffset;
+      available = value.length() - valueOffset;
+    } else {
+      available = 0;
+    }
+    if(!available){
+      _templateSegment++;
+      _templateOffset = 0;
+      continue;
+    }
+    size_t n = (available > len - outLen)?(len - outLen):available;
+    memcpy(data + outLen, src, n);
+    outLen += n;
+    _templateOffset += n;
+  }
+  return outLen;
+}
+
 size_t AsyncAbstractResponse::_fillBufferAndProcessTemplates(uint8_t* data, size_t len)
 {
+  if(_template)
+    return _renderTemplate(data, len);
   if(!_callback)
     return _fillBuffer(data, len);
 
@@ -417,13 +716,13 @@ size_t AsyncAbstractResponse::_fillBufferAndProcessTemplates(uint8_t* data, size
           *pTemplateEnd = 0;
           paramName = String(reinterpret_cast<char*>(buf));
           // Copy remaining read-ahead data into cache
-          _cache.insert(_cache.begin(), pTemplateEnd + 1, buf + (&data[len - 1] - pTemplateStart) + readFromCacheOrContent);
+          _cachePrepend(pTemplateEnd + 1, buf + (&data[len - 1] - pTemplateStart) + readFromCacheOrContent);
           pTemplateEnd = &data[len - 1];
         }
         else // closing placeholder not found in file data, store found percent symbol as is and advance to the next position
         {
           // but first, store read file data in cache
-          _cache.insert(_cache.begin(), buf + (&data[len - 1] - pTemplateStart), buf + (&data[len - 1] - pTemplateStart) + readFromCacheOrContent);
+          _cachePrepend(buf + (&data[len - 1] - pTemplateStart), buf + (&data[len - 1] - pTemplateStart) + readFromCacheOrContent);
           ++pTemplateStart;
         }
       }
@@ -445,7 +744,7 @@ size_t AsyncAbstractResponse::_fillBufferAndProcessTemplates(uint8_t* data, size
       // make room for param value
       // 1. move extra data to cache if parameter value is longer than placeholder AND if there is no room to store
       if((pTemplateEnd + 1 < pTemplateStart + numBytesCopied) && (originalLen - (pTemplateStart + numBytesCopied - pTemplateEnd - 1) < len)) {
-        _cache.insert(_cache.begin(), &data[originalLen - (pTemplateStart + numBytesCopied - pTemplateEnd - 1)], &data[len]);
+        _cachePrepend(&data[originalLen - (pTemplateStart + numBytesCopied - pTemplateEnd - 1)], &data[len]);
         //2. parameter value is longer than placeholder text, push the data after placeholder which not saved into cache further to the end
         memmove(pTemplateStart + numBytesCopied, pTemplateEnd + 1, &data[originalLen] - pTemplateStart - numBytesCopied);
         len = originalLen; // fix issue with truncated data, not sure if it has any side effects
@@ -457,7 +756,7 @@ size_t AsyncAbstractResponse::_fillBufferAndProcessTemplates(uint8_t* data, size
       memcpy(pTemplateStart, pvstr, numBytesCopied);
       // If result is longer than buffer, copy the remainder into cache (this could happen only if placeholder text itself did not fit entirely in buffer)
       if(numBytesCopied < pvlen) {
-        _cache.insert(_cache.begin(), pvstr + numBytesCopied, pvstr + pvlen);
+        _cachePrepend((const uint8_t*)pvstr + numBytesCopied, (const uint8_t*)pvstr + pvlen);
       } else if(pTemplateStart + numBytesCopied < pTemplateEnd + 1) { // result is copied fully; if result is shorter than placeholder text...
         // there is some free room, fill it from cache
         const size_t roomFreed = pTemplateEnd + 1 - pTemplateStart - numBytesCopied;
@@ -478,33 +777,46 @@ size_t AsyncAbstractResponse::_fillBufferAndProcessTemplates(uint8_t* data, size
  * */
 
 AsyncFileResponse::~AsyncFileResponse(){
+  if(_stream)
+    _stream->close();
   if(_content)
     _content.close();
 }
 
+const char* AsyncFileResponse::contentTypeFor(const String& path){
+  if (path.endsWith(".html")) return "text/html";
+  else if (path.endsWith(".htm")) return "text/html";
+  else if (path.endsWith(".css")) return "text/css";
+  else if (path.endsWith(".json")) return "application/json";
+  else if (path.endsWith(".js")) return "application/javascript";
+  else if (path.endsWith(".png")) return "image/png";
+  else if (path.endsWith(".gif")) return "image/gif";
+  else if (path.endsWith(".jpg")) return "image/jpeg";
+  else if (path.endsWith(".ico")) return "image/x-icon";
+  else if (path.endsWith(".svg")) return "image/svg+xml";
+  else if (path.endsWith(".eot")) return "font/eot";
+  else if (path.endsWith(".woff")) return "font/woff";
+  else if (path.endsWith(".woff2")) return "font/woff2";
+  else if (path.endsWith(".ttf")) return "font/ttf";
+  else if (path.endsWith(".xml")) return "text/xml";
+  else if (path.endsWith(".pdf")) return "application/pdf";
+  else if (path.endsWith(".zip")) return "application/zip";
+  else if(path.endsWith(".gz")) return "application/x-gzip";
+  else return "text/plain";
+}
+
 void AsyncFileResponse::_setContentType(const String& path){
-  if (path.endsWith(".html")) _contentType = "text/html";
-  else if (path.endsWith(".htm")) _contentType = "text/html";
-  else if (path.endsWith(".css")) _contentType = "text/css";
-  else if (path.endsWith(".json")) _contentType = "application/json";
-  else if (path.endsWith(".js")) _contentType = "application/javascript";
-  else if (path.endsWith(".png")) _contentType = "image/png";
-  else if (path.endsWith(".gif")) _contentType = "image/gif";
-  else if (path.endsWith(".jpg")) _contentType = "image/jpeg";
-  else if (path.endsWith(".ico")) _contentType = "image/x-icon";
-  else if (path.endsWith(".svg")) _contentType = "image/svg+xml";
-  else if (path.endsWith(".eot")) _contentType = "font/eot";
-  else if (path.endsWith(".woff")) _contentType = "font/woff";
-  else if (path.endsWith(".woff2")) _contentType = "font/woff2";
-  else if (path.endsWith(".ttf")) _contentType = "font/ttf";
-  else if (path.endsWith(".xml")) _contentType = "text/xml";
-  else if (path.endsWith(".pdf")) _contentType = "application/pdf";
-  else if (path.endsWith(".zip")) _contentType = "application/zip";
-  else if(path.endsWith(".gz")) _contentType = "application/x-gzip";
-  else _contentType = "text/plain";
-}
-
-AsyncFileResponse::AsyncFileResponse(FS &fs, const String& path, const String& contentType, bool download, AwsTemplateProcessor callback): AsyncAbstractResponse(callback){
+  _contentType = contentTypeFor(path);
+}
+
+AsyncFileResponse::AsyncFileResponse(FS &fs, const String& path, const String& contentType, bool download, AwsTemplateProcessor callback)
+  : AsyncAbstractResponse(callback)
+  , _stream(NULL)
+  , _ranges(NULL)
+  , _rangeCount(0)
+  , _part(0)
+  , _partPos(0)
+{
   _code = 200;
   _path = path;
 
@@ -518,6 +830,7 @@ AsyncFileResponse::AsyncFileResponse(FS &fs, const String& path, const String& c
 
   _content = fs.open(_path, "r");
   _contentLength = _content.size();
+  _compileTemplate(_path);
 
   if(contentType == "")
     _setContentType(path);
@@ -538,19 +851,34 @@ AsyncFileResponse::AsyncFileResponse(FS &fs, const String& path, const String& c
   addHeader("Content-Disposition", buf);
 }
 
-AsyncFileResponse::AsyncFileResponse(File content, const String& path, const String& contentType, bool download, AwsTemplateProcessor callback): AsyncAbstractResponse(callback){
+AsyncFileResponse::AsyncFileResponse(File content, const String& path, const String& contentType, bool download, AwsTemplateProcessor callback)
+  : AsyncAbstractResponse(callback)
+  , _stream(NULL)
+  , _ranges(NULL)
+  , _rangeCount(0)
+  , _part(0)
+  , _partPos(0)
+{
   _code = 200;
   _path = path;
 
-  if(!download && String(content.name()).endsWith(".gz") && !path.endsWith(".gz")){
-    addHeader("Content-Encoding", "gzip");
-    _callback = nullptr; // Unable to process gzipped templates
+  String stored(content.name());
+  const char* coding = stored.endsWith(".gz") && !path.endsWith(".gz") ? "gzip"
+    : stored.endsWith(".br") && !path.endsWith(".br") ? "br" : NULL;
+  if(!download && coding){
+    addHeader("Content-Encoding", coding);
+    _callback = nullptr; // Unable to process compressed templates
     _sendContentLength = true;
     _chunked = false;
   }
 
   _content = content;
   _contentLength = _content.size();
+#ifdef ESP32
+  _compileTemplate(String(_content.path()));
+#else
+  _compileTemplate(_path);
+#endif
 
   if(contentType == "")
     _setContentType(path);
@@ -569,10 +897,228 @@ AsyncFileResponse::AsyncFileResponse(File content, const String& path, const Str
   addHeader("Content-Disposition", buf);
 }
 
+// Templates small enough are compiled (or taken from the cache), the file is not needed after that
+void AsyncFileResponse::_compileTemplate(const String& key){
+  if(!_callback || !_content)
+    return;
+  _template = AsyncWebTemplate::forFile(_content, key);
+  if(_template)
+    _content.close();
+}
+
 size_t AsyncFileResponse::_fillBuffer(uint8_t *data, size_t len){
+  if(_stream)
+    return _stream->read(data, len);
+  if(_rangeCount > 1)
+    return _fillParts(data, len);
   return _content.read(data, len);
 }
 
+/*
+ * Ranges :: "Range: bytes=..." applied to the file before the head is sent
+ *
+ * A single range is sent as it is with a Content-Range header, several go
+ * out as multipart/byteranges whose part headers are written while filling.
+ * An If-Range that does not match the ETag or Last-Modified given to the
+ * response, an unparsable Range, overlapping ranges or more than
+ * ASYNCWEBSERVER_MAX_RANGES of them get the whole file instead.
+ * */
+
+// Satisfiable ranges of spec for a file of size bytes, -1 when the whole file should be sent
+static int parseRanges(const char* spec, size_t size, AsyncFileRange* out, size_t max){
+  if(strncasecmp(spec, "bytes=", 6) != 0)
+    return -1;
+  const char* p = spec + 6;
+  int count = 0;
+  bool specs = false;
+  while(*p){
+    while(*p == ' ' || *p == ',')
+      p++;
+    if(!*p)
+      break;
+    size_t first = 0, last = 0;
+    bool hasFirst = false, hasLast = false;
+    for(; *p >= '0' && *p <= '9'; p++){
+      if(first > (SIZE_MAX - 9) / 10)
+        return -1;
+      first = first * 10 + (*p - '0');
+      hasFirst = true;
+    }
+    if(*p++ != '-')
+      return -1;
+    for(; *p >= '0' && *p <= '9'; p++){
+      if(last > (SIZE_MAX - 9) / 10)
+        return -1;
+      last = last * 10 + (*p - '0');
+      hasLast = true;
+    }
+    while(*p == ' ')
+      p++;
+    if(*p && *p != ',')
+      return -1;
+    if((!hasFirst && !hasLast) || (hasFirst && hasLast && last < first))
+      return -1;
+    specs = true;
+
+    AsyncFileRange range;
+    if(!hasFirst){
+      // suffix: the last bytes of the file
+      if(last == 0)
+        continue;
+      range.start = last < size ? size - last : 0;
+      range.end = size;
+    } else {
+      if(first >= size)
+        continue;
+      range.start = first;
+      range.end = (hasLast && last < size) ? last + 1 : size;
+    }
+    if((size_t)count == max)
+      return -1;
+    out[count++] = range;
+  }
+  if(!specs)
+    return -1;
+  for(int i = 0; i < count; i++){
+    for(int j = i + 1; j < count; j++){
+      if(out[i].start < out[j].end && out[j].start < out[i].end)
+        return -1;
+    }
+  }
+  return count;
+}
+
+bool AsyncFileResponse::_ifRangeMatches(const String& value){
+  // a quoted value is an entity tag and must match strongly, anything else is a date
+  if(value.startsWith("W/"))
+    return false;
+  const char* name = value.startsWith("\"") ? "ETag" : "Last-Modified";
+  for(const auto& header: _headers){
+    if(header->name().equalsIgnoreCase(name))
+      return header->value() == value && !header->value().startsWith("W/");
+  }
+  return false;
+}
+
+String AsyncFileResponse::_partHeader(size_t part){
+  String head = "--";
+  head += _boundary;
+  if(part == _rangeCount){
+    head += "--\r\n";
+    return head;
+  }
+  char range[72];
+  snprintf(range, sizeof(range), "\r\nContent-Range: bytes %u-%u/%u\r\n\r\n",
+    (unsigned)_ranges[part].start, (unsigned)(_ranges[part].end - 1), (unsigned)_content.size());
+  head += "\r\nContent-Type: ";
+  head += _partType;
+  head += range;
+  return head;
+}
+
+void AsyncFileResponse::_applyRange(AsyncWebServerRequest *request){
+  if(_callback || _template || !_content || _code != 200)
+    return;
+  _acceptRanges = true;
+  if(!request->hasHeader("Range"))
+    return;
+  if(request->hasHeader("If-Range") && !_ifRangeMatches(request->header("If-Range")))
+    return;
+
+  size_t size = _content.size();
+  AsyncFileRange ranges[ASYNCWEBSERVER_MAX_RANGES];
+  int count = parseRanges(request->header("Range").c_str(), size, ranges, ASYNCWEBSERVER_MAX_RANGES);
+  if(count < 0)
+    return;
+
+  char value[48];
+  if(count == 0){
+    _code = 416;
+    snprintf(value, sizeof(value), "bytes */%u", (unsigned)size);
+    addHeader("Content-Range", value);
+    _contentType = String();
+    _contentLength = 0;
+    return;
+  }
+
+  _code = 206;
+  if(count == 1){
+    snprintf(value, sizeof(value), "bytes %u-%u/%u", (unsigned)ranges[0].start, (unsigned)(ranges[0].end - 1), (unsigned)size);
+    addHeader("Content-Range", value);
+    _content.seek(ranges[0].start);
+    _contentLength = ranges[0].end - ranges[0].start;
+    return;
+  }
+
+  _ranges = (AsyncFileRange*)request->arena().alloc(sizeof(AsyncFileRange) * count, alignof(AsyncFileRange));
+  if(_ranges == NULL){
+    _code = 200; // not worth failing for, the whole file still works
+    return;
+  }
+  memcpy(_ranges, ranges, sizeof(AsyncFileRange) * count);
+  _rangeCount = count;
+  snprintf(_boundary, sizeof(_boundary), "%08x%08x", (unsigned)(uintptr_t)this, (unsigned)micros());
+  _partType = _contentType;
+  _contentType = String("multipart/byteranges; boundary=") + _boundary;
+  _contentLength = 0;
+  for(size_t i = 0; i <= _rangeCount; i++){
+    _contentLength += _partHeader(i).length();
+    if(i < _rangeCount)
+      _contentLength += _ranges[i].end - _ranges[i].start + 2;
+  }
+}
+
+size_t AsyncFileResponse::_fillParts(uint8_t *data, size_t len){
+  size_t n = 0;
+  while(n < len && _part <= _rangeCount){
+    if(_partPos == 0)
+      _partHead = _partHeader(_part);
+    size_t headLen = _partHead.length();
+    size_t dataLen = (_part < _rangeCount) ? _ranges[_part].end - _ranges[_part].start : 0;
+    size_t tailLen = (_part < _rangeCount) ? 2 : 0; // CRLF in front of the next delimiter
+    size_t m;
+    if(_partPos < headLen){
+      m = std::min(len - n, headLen - _partPos);
+      memcpy(data + n, _partHead.c_str() + _partPos, m);
+    } else if(_partPos < headLen + dataLen){
+      size_t at = _partPos - headLen;
+      if(at == 0)
+        _content.seek(_ranges[_part].start);
+      m = _content.read(data + n, std::min(len - n, dataLen - at));
+      if(m == 0)
+        break;
+    } else if(_partPos < headLen + dataLen + tailLen){
+      size_t at = _partPos - headLen - dataLen;
+      m = std::min(len - n, tailLen - at);
+      memcpy(data + n, "\r\n" + at, m);
+    } else {
+      _part++;
+      _partPos = 0;
+      continue;
+    }
+    n += m;
+    _partPos += m;
+  }
+  return n;
+}
+
+/*
+ * Content read straight through, the whole file or one range, comes from the reader task.
+ * Multipart ranges seek between parts and templates need every fill to succeed, both
+ * keep reading inline.
+ * */
+void AsyncFileResponse::_openStream(AsyncWebServerRequest *request){
+  if(!_content || _callback || _template || _rangeCount > 1 || (_code != 200 && _code != 206))
+    return;
+  _stream = AsyncWebFileStream::open(_content, (_code == 206) ? _contentLength : SIZE_MAX, request->client());
+}
+
+void AsyncFileResponse::_respond(AsyncWebServerRequest *request){
+  _applyRange(request);
+  _openStream(request);
+  AsyncAbstractResponse::_respond(request);
+}
+
 /*
  * Stream Response
  * */
@@ -0,0 +1,296 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ESPAsyncWebServer.h"
+
+uint32_t AsyncWebRouter::_generation = 1;
+
+AsyncWebRouter::AsyncWebRouter()
+  : _arena()
+  , _root(NULL)
+  , _any(NULL)
+  , _extensions(NULL)
+  , _fallback(NULL)
+  , _builtGeneration(0)
+{}
+
+AsyncWebRouter::Node* AsyncWebRouter::_newNode(const char* label, size_t len){
+  Node* node = _arena.create<Node>();
+  if(node == NULL)
+    return NULL;
+  node->label = len ? _arena.strdup(label, len) : "";
+  node->len = len;
+  node->methods = 0;
+  node->children = NULL;
+  node->sibling = NULL;
+  node->param = NULL;
+  node->routes = NULL;
+  node->wildcards = NULL;
+  return node;
+}
+
+AsyncWebRouter::Node* AsyncWebRouter::_child(Node* node, const char* label, size_t len){
+  if(len > 2 && label[0] == '{' && label[len - 1] == '}'){
+    if(node->param == NULL)
+      node->param = _newNode(label, len);
+    return node->param;
+  }
+  for(Node* c = node->children; c; c = c->sibling){
+    if(c->len == len && !memcmp(c->label, label, len))
+      return c;
+  }
+  Node* c = _newNode(label, len);
+  if(c){
+    c->sibling = node->children;
+    node->children = c;
+  }
+  return c;
+}
+
+AsyncWebRouter::Route* AsyncWebRouter::_newRoute(AsyncWebHandler* handler, uint16_t order, WebRequestMethodComposite method, const char* partial, size_t partialLen){
+  Route* route = _arena.create<Route>();
+  if(route == NULL)
+    return NULL;
+  route->handler = handler;
+  route->order = order;
+  route->method = method;
+  route->partial = partialLen ? _arena.strdup(partial, partialLen) : "";
+  route->partialLen = partialLen;
+  route->next = NULL;
+  return route;
+}
+
+void AsyncWebRouter::_append(Route** list, Route* route){
+  while(*list)
+    list = &(*list)->next;
+  *list = route;
+}
+
+bool AsyncWebRouter::_insert(AsyncWebHandler* handler, uint16_t order){
+  const String* uri = NULL;
+  WebRequestMethodComposite method = HTTP_ANY;
+  if(!handler->_getRoute(&uri, &method) || uri == NULL)
+    return false;
+
+  const char* u = uri->c_str();
+  size_t len = uri->length();
+
+  // Same precedence as AsyncCallbackWebHandler::canHandle()
+  if(!len){
+    Route* route = _newRoute(handler, order, method, NULL, 0);
+    if(route == NULL)
+      return false;
+    _append(&_any, route);
+    return true;
+  }
+
+  if(uri->startsWith("/*.")){
+    int dot = uri->lastIndexOf('.');
+    Route* route = _newRoute(handler, order, method, u + dot, len - dot);
+    if(route == NULL)
+      return false;
+    _append(&_extensions, route);
+    return true;
+  }
+
+  if(u[0] != '/')
+    return false;
+
+  bool wildcard = u[len - 1] == '*';
+  const char* p = u + 1;
+  const char* end = u + len - (wildcard ? 1 : 0);
+  const char* last = end;
+  if(wildcard){
+    // full segments go into the trie, whatever follows the last '/' has to prefix the next url segment
+    last = p;
+    for(const char* c = p; c < end; c++){
+      if(*c == '/')
+        last = c + 1;
+    }
+  }
+
+  Node* path[32];
+  size_t depth = 0;
+  Node* node = _root;
+  path[depth++] = node;
+  if(!wildcard || last > p){
+    const char* segEnd = wildcard ? last - 1 : end;
+    while(true){
+      const char* q = (const char*)memchr(p, '/', segEnd - p);
+      if(q == NULL)
+        q = segEnd;
+      if(depth == sizeof(path) / sizeof(path[0]))
+        return false;
+      node = _child(node, p, q - p);
+      if(node == NULL)
+        return false;
+      path[depth++] = node;
+      if(q == segEnd)
+        break;
+      p = q + 1;
+    }
+  }
+
+  Route* route = wildcard ? _newRoute(handler, order, method, last, end - last) : _newRoute(handler, order, method, NULL, 0);
+  if(route == NULL)
+    return false;
+  _append(wildcard ? &node->wildcards : &node->routes, route);
+  for(size_t i = 0; i < depth; i++)
+    path[i]->methods |= method;
+  return true;
+}
+
+void AsyncWebRouter::build(const LinkedList<AsyncWebHandler*>& handlers){
+  _arena.release();
+  _any = NULL;
+  _extensions = NULL;
+  _fallback = NULL;
+  _root = _newNode(NULL, 0);
+  uint16_t order = 0;
+  for(const auto& h: handlers){
+    if(_root == NULL || !_insert(h, order)){
+      Route* route = _newRoute(h, order, HTTP_ANY, NULL, 0);
+      if(route)
+        _append(&_fallback, route);
+    }
+    order++;
+  }
+  _builtGeneration = _generation;
+}
+
+void AsyncWebRouter::_consider(const Route* route, Match* m){
+  if((route->method & m->method) && route->order >= m->minOrder && (m->best == NULL || route->order < m->best->order)){
+    m->best = route;
+    m->bestArgs = m->args;
+  }
+}
+
+void AsyncWebRouter::_walk(const Node* node, const char* p, const char* end, bool more, Match* m) const {
+  if(!(node->methods & m->method))
+    return;
+  for(const Route* r = node->routes; r; r = r->next)
+    _consider(r, m);
+  if(!more)
+    return;
+
+  const char* q = (const char*)memchr(p, '/', end - p);
+  if(q == NULL)
+    q = end;
+  size_t len = q - p;
+
+  for(const Route* w = node->wildcards; w; w = w->next){
+    if(w->partialLen <= len && !memcmp(p, w->partial, w->partialLen))
+      _consider(w, m);
+  }
+
+  bool nextMore = q < end;
+  const char* next = nextMore ? q + 1 : end;
+  for(const Node* c = node->children; c; c = c->sibling){
+    if(c->len == len && !memcmp(c->label, p, len)){
+      _walk(c, next, end, nextMore, m);
+      break;
+    }
+  }
+  if(node->param && len){
+    uint8_t count = m->args.count;
+    if(m->args.add(p - m->url, len)){
+      _walk(node->param, next, end, nextMore, m);
+      m->args.count = count;
+    }
+  }
+}
+
+void AsyncWebRouter::_match(const char* url, size_t len, Match* m) const {
+  m->url = url;
+  m->args.count = 0;
+  m->best = NULL;
+  m->bestArgs.count = 0;
+  for(const Route* r = _any; r; r = r->next)
+    _consider(r, m);
+  for(const Route* e = _extensions; e; e = e->next){
+    if(len >= e->partialLen && !memcmp(url + len - e->partialLen, e->partial, e->partialLen))
+      _consider(e, m);
+  }
+  if(_root && len && url[0] == '/')
+    _walk(_root, url + 1, url + len, true, m);
+}
+
+AsyncWebHandler* AsyncWebRouter::find(AsyncWebServerRequest *request) const {
+  const String& url = request->url();
+  const Route* fallback = _fallback;
+  Match m;
+  m.method = request->method();
+  m.minOrder = 0;
+  request->_setPathArgs(AsyncWebPathArgs());
+  while(true){
+    _match(url.c_str(), url.length(), &m);
+    const Route* route = m.best;
+    // handlers the table knows nothing about are asked in registration order, as before
+    for(; fallback && (route == NULL || fallback->order < route->order); fallback = fallback->next){
+      if(fallback->handler->filter(request) && fallback->handler->canHandle(request))
+        return fallback->handler;
+    }
+    if(route == NULL)
+      return NULL;
+    request->_setPathArgs(m.bestArgs);
+    if(route->handler->filter(request) && route->handler->_routeMatched(request))
+      return route->handler;
+    request->_setPathArgs(AsyncWebPathArgs());
+    m.minOrder = route->order + 1;
+  }
+}
+
+bool AsyncWebRouter::matchTemplate(const String& uri, const String& url, AsyncWebPathArgs* args){
+  const char* t = uri.c_str();
+  const char* tend = t + uri.length();
+  const char* u = url.c_str();
+  const char* uend = u + url.length();
+  bool wildcard = tend > t && tend[-1] == '*';
+  if(wildcard)
+    tend--;
+  args->count = 0;
+  while(t < tend){
+    const char* ts = (const char*)memchr(t, '/', tend - t);
+    if(ts == NULL)
+      ts = tend;
+    const char* us = (const char*)memchr(u, '/', uend - u);
+    if(us == NULL)
+      us = uend;
+    size_t tlen = ts - t;
+    size_t ulen = us - u;
+    if(wildcard && ts == tend) // whatever follows the last '/' has to prefix the next url segment
+      return ulen >= tlen && !memcmp(u, t, tlen);
+    if(tlen > 2 && t[0] == '{' && t[tlen - 1] == '}'){
+      if(!ulen || !args->add(u - url.c_str(), ulen))
+        return false;
+    } else if(tlen != ulen || memcmp(t, u, tlen)){
+      return false;
+    }
+    t = ts;
+    u = us;
+    if(t < tend){
+      if(u == uend)
+        return false;
+      t++;
+      u++;
+    }
+  }
+  return wildcard || u == uend || *u == '/';
+}
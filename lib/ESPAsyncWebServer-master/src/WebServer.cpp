@@ -34,6 +34,7 @@ AsyncWebServer::AsyncWebServer(uint16_t port)
   : _server(port)
   , _rewrites(LinkedList<AsyncWebRewrite*>([](AsyncWebRewrite* r){ delete r; }))
   , _handlers(LinkedList<AsyncWebHandler*>([](AsyncWebHandler* h){ delete h; }))
+  , _requestPool(NULL)
 {
   _catchAllHandler = new AsyncCallbackWebHandler();
   if(_catchAllHandler == NULL)
@@ -42,7 +43,15 @@ AsyncWebServer::AsyncWebServer(uint16_t port)
     if(c == NULL)
       return;
     c->setRxTimeout(3);
-    AsyncWebServerRequest *r = new AsyncWebServerRequest((AsyncWebServer*)s, c);
+    AsyncWebServer* server = (AsyncWebServer*)s;
+    AsyncWebServerRequest *r = NULL;
+    if(server->_requestPool){
+      void* slot = server->_requestPool->take();
+      if(slot)
+        r = new (slot) AsyncWebServerRequest(server, c);
+    } else {
+      r = new AsyncWebServerRequest(server, c);
+    }
     if(r == NULL){
       c->close(true);
       c->free();
@@ -55,6 +64,9 @@ AsyncWebServer::~AsyncWebServer(){
   reset();  
   end();
   if(_catchAllHandler) delete _catchAllHandler;
+  // requests still alive will hand their slot back on delete, keep the pool for them
+  if(_requestPool && _requestPool->available() == _requestPool->capacity())
+    delete _requestPool;
 }
 
 AsyncWebRewrite& AsyncWebServer::addRewrite(AsyncWebRewrite* rewrite){
@@ -72,16 +84,40 @@ AsyncWebRewrite& AsyncWebServer::rewrite(const char* from, const char* to){
 
 AsyncWebHandler& AsyncWebServer::addHandler(AsyncWebHandler* handler){
   _handlers.add(handler);
+  AsyncWebRouter::changed();
   return *handler;
 }
 
 bool AsyncWebServer::removeHandler(AsyncWebHandler *handler){
+  AsyncWebRouter::changed();
   return _handlers.remove(handler);
 }
 
-void AsyncWebServer::begin(){
+AsyncWebPool* AsyncWebServer::_txPool = NULL;
+size_t AsyncWebServer::_txMisses = 0;
+
+void AsyncWebServer::begin(size_t maxConnections){
+  // shared by every server instance and never freed
+  if(ASYNCWEBSERVER_TX_BUFFERS && _txPool == NULL){
+    _txPool = new AsyncWebPool(ASYNCWEBSERVER_TX_BUFFER_SIZE, ASYNCWEBSERVER_TX_BUFFERS);
+    if(!_txPool->valid()){
+      delete _txPool;
+      _txPool = NULL;
+    }
+  }
+  if(maxConnections && _requestPool == NULL){
+    _requestPool = new AsyncWebPool(sizeof(AsyncWebServerRequest), maxConnections);
+    if(!_requestPool->valid()){
+      delete _requestPool;
+      _requestPool = NULL;
+    }
+  }
   _server.setNoDelay(true);
+#ifdef ESP32
+  _server.begin(maxConnections);
+#else
   _server.begin();
+#endif
 }
 
 void AsyncWebServer::end(){
@@ -112,11 +148,12 @@ void AsyncWebServer::_rewriteRequest(AsyncWebServerRequest *request){
 }
 
 void AsyncWebServer::_attachHandler(AsyncWebServerRequest *request){
-  for(const auto& h: _handlers){
-    if (h->filter(request) && h->canHandle(request)){
-      request->setHandler(h);
-      return;
-    }
+  if(_router.dirty())
+    _router.build(_handlers);
+  AsyncWebHandler* h = _router.find(request);
+  if(h){
+    request->setHandler(h);
+    return;
   }
   
   request->addInterestingHeader("ANY");
@@ -168,6 +205,12 @@ AsyncStaticWebHandler& AsyncWebServer::serveStatic(const char* uri, fs::FS& fs,
   return *handler;
 }
 
+AsyncEmbeddedWebHandler& AsyncWebServer::serveEmbedded(const char* uri, const AsyncWebAssetTable& assets, const char* cache_control){
+  AsyncEmbeddedWebHandler* handler = new AsyncEmbeddedWebHandler(uri, assets, cache_control);
+  addHandler(handler);
+  return *handler;
+}
+
 void AsyncWebServer::onNotFound(ArRequestHandlerFunction fn){
   _catchAllHandler->onRequest(fn);
 }
@@ -183,6 +226,7 @@ void AsyncWebServer::onRequestBody(ArBodyHandlerFunction fn){
 void AsyncWebServer::reset(){
   _rewrites.free();
   _handlers.free();
+  AsyncWebRouter::changed();
   
   if (_catchAllHandler != NULL){
     _catchAllHandler->onRequest(NULL);
@@ -0,0 +1,408 @@
+"""
+PlatformIO extra script: builds the file system image from data/ through an asset pipeline.
+
+Every HTML page in data/ keeps its name and is minified. Its stylesheets and scripts, local
+or from a CDN, inline or linked, are bundled into one CSS and one JS file per page, minified,
+gzipped and written under /assets/ with a content hash in the name; the page is rewritten to
+reference them. Images, fonts and other files referenced by a page or stylesheet get hashed
+names as well. Files no page references are copied unchanged.
+
+The hashed files never change under their name. They are listed in /assets.manifest, which
+serveStatic().setImmutable("/assets.manifest") reads to send them with
+"Cache-Control: public, max-age=31536000, immutable".
+
+CDN files are downloaded once into .pio/web-cache; the device never needs internet access.
+For an offline build machine, place the files there under the names the error message shows.
+
+With "custom_web_embed = yes" in platformio.ini the same output is compiled into the firmware
+instead: web_assets.h (on the include path, WEB_ASSETS_EMBEDDED defined) holds every file as a
+PROGMEM array and a perfect-hash table for server.serveEmbedded(), no file system needed.
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import shutil
+import urllib.parse
+import urllib.request
+
+Import("env")  # noqa: F821 (provided by PlatformIO)
+
+FS_TARGETS = ("buildfs", "uploadfs", "uploadfsota")
+ASSET_DIR = "/assets/"
+MANIFEST = "/assets.manifest"
+EMBED_HEADER = "web_assets.h"
+NAME_MAX = 31  # SPIFFS_OBJ_NAME_LEN minus the terminating zero
+COMPRESSIBLE = (".css", ".js", ".svg", ".json", ".txt", ".html", ".ico", ".ttf", ".eot")
+
+
+class Pipeline:
+    def __init__(self, source, output, cache):
+        self.source = source
+        self.output = output
+        self.cache = cache
+        self.manifest = []
+        self.emitted = {}  # content hash and name -> served path
+        self.consumed = set()  # source files that went into a bundle or got a hashed name
+
+    # -- sources ----------------------------------------------------------------------------
+
+    def read(self, ref, base):
+        """Returns (bytes, location, remote) for a reference relative to base (a path or URL)."""
+        ref = ref.split("#")[0]
+        if ref.startswith("//"):
+            ref = "https:" + ref
+        if re.match(r"https?://", ref) or re.match(r"https?://", base):
+            url = urllib.parse.urljoin(base, ref)
+            return self.fetch(url), url, True
+        ref = ref.split("?")[0]
+        if ref.startswith("/"):
+            path = os.path.join(self.source, ref.lstrip("/"))
+        else:
+            path = os.path.join(os.path.dirname(base), ref)
+        path = os.path.normpath(path)
+        with open(path, "rb") as f:
+            data = f.read()
+        self.consumed.add(path)
+        return data, path, False
+
+    def fetch(self, url):
+        name = hashlib.sha1(url.encode()).hexdigest()[:16] + "-" + os.path.basename(urllib.parse.urlparse(url).path)
+        path = os.path.join(self.cache, name)
+        if not os.path.isfile(path):
+            print("web: fetching %s" % url)
+            try:
+                with urllib.request.urlopen(url, timeout=30) as r:
+                    data = r.read()
+            except Exception as e:
+                raise SystemExit("web: cannot fetch %s (%s), place a copy at %s" % (url, e, path))
+            os.makedirs(self.cache, exist_ok=True)
+            with open(path, "wb") as f:
+                f.write(data)
+        with open(path, "rb") as f:
+            return f.read()
+
+    # -- output -----------------------------------------------------------------------------
+
+    def emit(self, stem, ext, data, source):
+        """Writes data under a content-hashed name and returns the path it is served under."""
+        digest = hashlib.sha256(data).hexdigest()[:8]
+        compress = ext in COMPRESSIBLE
+        fixed = len(ASSET_DIR) + 1 + len(digest) + len(ext) + (3 if compress else 0)
+        stem = re.sub(r"[^A-Za-z0-9_-]", "", stem)[:max(0, NAME_MAX - fixed)] or "a"
+        served = "%s%s.%s%s" % (ASSET_DIR, stem, digest, ext)
+        if (digest, served) in self.emitted:
+            return served
+        self.emitted[(digest, served)] = served
+        name = served
+        if compress:
+            packed = gzip.compress(data, 9, mtime=0)
+            if len(packed) < len(data):
+                data, name = packed, served + ".gz"
+        self.write(name, data)
+        self.manifest.append("%s\t%s" % (served, source))
+        return served
+
+    def write(self, name, data):
+        path = os.path.join(self.output, name.lstrip("/"))
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "wb") as f:
+            f.write(data)
+
+    def asset(self, ref, base):
+        """A referenced file (image, font, ...) under its hashed name, or ref itself if it is not one."""
+        if re.match(r"(data|mailto|javascript):|#", ref) or ref.split("?")[0].endswith(".html"):
+            return ref
+        data, location, _ = self.read(ref, base)
+        stem, ext = os.path.splitext(os.path.basename(location.split("?")[0]))
+        if ext == ".css":
+            data = minify_css(self.css_urls(data.decode(), location)).encode()
+        return self.emit(stem, ext.lower(), data, os.path.basename(location))
+
+    # -- pages ------------------------------------------------------------------------------
+
+    def css_urls(self, css, base):
+        def rewrite(m):
+            return "url(%s)" % self.asset(m.group(2), base)
+        return re.sub(r"url\(\s*(['\"]?)([^'\")]+)\1\s*\)", rewrite, css)
+
+    def page(self, path):
+        with open(path, encoding="utf-8") as f:
+            html = f.read()
+        styles, scripts = [], []
+
+        def style(m):
+            styles.append(minify_css(self.css_urls(m.group(1), path)))
+            return "\0css\0" if len(styles) == 1 else ""
+
+        def link(m):
+            attrs = m.group(1)
+            rel = attribute(attrs, "rel").lower()
+            href = attribute(attrs, "href")
+            if rel == "stylesheet" and href:
+                data, location, _ = self.read(href, path)
+                styles.append(minify_css(self.css_urls(data.decode(), location)))
+                return "\0css\0" if len(styles) == 1 else ""
+            if href:
+                return m.group(0).replace(href, self.asset(href, path))
+            return m.group(0)
+
+        def script(m):
+            attrs, body = m.group(1), m.group(2)
+            kind = attribute(attrs, "type").lower()
+            if kind and kind not in ("text/javascript", "application/javascript"):
+                return m.group(0)
+            src = attribute(attrs, "src")
+            if src:
+                data, location, remote = self.read(src, path)
+                code = data.decode()
+                if not (remote or location.endswith(".min.js")):
+                    code = minify_js(code)
+            else:
+                code = minify_js(body)
+            scripts.append(code.strip())
+            return "\0js\0" if len(scripts) == 1 else ""
+
+        def reference(m):
+            return '%s="%s"' % (m.group(1), self.asset(m.group(2), path))
+
+        html = re.sub(r"<style[^>]*>(.*?)</style>", style, html, flags=re.S | re.I)
+        html = re.sub(r"<link\b([^>]*)>", link, html, flags=re.S | re.I)
+        html = re.sub(r"<script\b([^>]*)>(.*?)</script>", script, html, flags=re.S | re.I)
+        html = re.sub(r"\b(src|poster)=\"([^\"]+)\"", reference, html, flags=re.I)
+        html = minify_html(html)
+
+        stem = os.path.splitext(os.path.basename(path))[0]
+        if styles:
+            css = self.emit(stem, ".css", "\n".join(styles).encode(), os.path.basename(path))
+            html = html.replace("\0css\0", '<link rel="stylesheet" href="%s">' % css)
+        if scripts:
+            # deferred, so a bundle taking the place of scripts at the end of the body still sees the DOM
+            js = self.emit(stem, ".js", ";\n".join(scripts).encode(), os.path.basename(path))
+            html = html.replace("\0js\0", '<script defer src="%s"></script>' % js)
+        return html
+
+    def run(self):
+        if os.path.isdir(self.output):
+            shutil.rmtree(self.output)
+        os.makedirs(self.output)
+        pages = []
+        for root, _, files in os.walk(self.source):
+            for name in sorted(files):
+                if name.endswith(".html"):
+                    pages.append(os.path.join(root, name))
+        for path in pages:
+            self.write("/" + os.path.relpath(path, self.source), self.page(path).encode("utf-8"))
+        for root, _, files in os.walk(self.source):
+            for name in sorted(files):
+                path = os.path.normpath(os.path.join(root, name))
+                if path in self.consumed or name.endswith(".html"):
+                    continue
+                with open(path, "rb") as f:
+                    self.write("/" + os.path.relpath(path, self.source), f.read())
+        self.write(MANIFEST, ("\n".join(self.manifest) + "\n").encode())
+        print("web: %d pages, %d hashed assets in %s" % (len(pages), len(self.manifest), self.output))
+
+
+CONTENT_TYPES = {
+    ".html": "text/html", ".htm": "text/html", ".css": "text/css", ".json": "application/json",
+    ".js": "application/javascript", ".png": "image/png", ".gif": "image/gif", ".jpg": "image/jpeg",
+    ".ico": "image/x-icon", ".svg": "image/svg+xml", ".eot": "font/eot", ".woff": "font/woff",
+    ".woff2": "font/woff2", ".ttf": "font/ttf", ".xml": "text/xml", ".pdf": "application/pdf",
+    ".zip": "application/zip", ".gz": "application/x-gzip",
+}  # as AsyncFileResponse::contentTypeFor()
+
+
+def fnv1a(seed, text):
+    """The hash AsyncWebAssetTable::find() uses."""
+    h = 2166136261 ^ seed
+    for b in text.encode():
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def perfect_hash(paths):
+    """(seed, slots): every path gets a slot of its own, slots are -1 or an index into paths."""
+    size = max(1, len(paths))
+    while True:
+        for seed in range(4096):
+            slots = [-1] * size
+            for i, path in enumerate(paths):
+                slot = fnv1a(seed, path) % size
+                if slots[slot] >= 0:
+                    break
+                slots[slot] = i
+            else:
+                return seed, slots
+        size += 1
+
+
+def write_embedded(output, header):
+    """Compiles the pipeline output in output into header."""
+    with open(os.path.join(output, MANIFEST.lstrip("/"))) as f:
+        immutable = set(line.split("\t")[0] for line in f if line.strip())
+    assets = []
+    for root, _, files in os.walk(output):
+        for name in sorted(files):
+            full = os.path.join(root, name)
+            path = "/" + os.path.relpath(full, output).replace(os.sep, "/")
+            if path == MANIFEST:
+                continue
+            with open(full, "rb") as f:
+                data = f.read()
+            compressed = path.endswith(".gz") and not os.path.isfile(full[:-3])
+            served = path[:-3] if compressed else path
+            kind = CONTENT_TYPES.get(os.path.splitext(served)[1].lower(), "text/plain")
+            etag = '\\"%s\\"' % hashlib.sha256(data).hexdigest()[:16]
+            assets.append((served, data, kind, etag, compressed, served in immutable))
+    assets.sort()
+    seed, slots = perfect_hash([a[0] for a in assets])
+
+    lines = ["// Generated by scripts/build_web.py from data/, do not edit", "#pragma once",
+             "#include <ESPAsyncWebServer.h>", ""]
+    for i, (served, data, _, _, _, _) in enumerate(assets):
+        lines.append("// %s" % served)
+        lines.append("static const uint8_t webAsset%d[] PROGMEM = {" % i)
+        for at in range(0, len(data), 24):
+            lines.append("  " + ",".join("0x%02x" % b for b in data[at:at + 24]) + ",")
+        lines.append("};")
+    lines.append("")
+    lines.append("static const AsyncWebAsset webAssetList[] = {")
+    for i, (served, data, kind, etag, compressed, fixed) in enumerate(assets):
+        lines.append('  {"%s", webAsset%d, %d, "%s", "%s", %s, %s},' % (
+            served, i, len(data), kind, etag, str(compressed).lower(), str(fixed).lower()))
+    lines.append("};")
+    lines.append("static const int16_t webAssetSlots[] = {%s};" % ", ".join(str(x) for x in slots))
+    lines.append("static const AsyncWebAssetTable webAssets = {webAssetList, webAssetSlots, %d, %uU};"
+                 % (len(slots), seed))
+    text = "\n".join(lines) + "\n"
+
+    os.makedirs(os.path.dirname(header), exist_ok=True)
+    if os.path.isfile(header):
+        with open(header) as f:
+            if f.read() == text:
+                return  # unchanged, keep its mtime so nothing is rebuilt
+    with open(header, "w") as f:
+        f.write(text)
+    print("web: %d assets embedded in %s" % (len(assets), header))
+
+
+def attribute(attrs, name):
+    m = re.search(r"\b%s\s*=\s*(\"([^\"]*)\"|'([^']*)'|([^\s>]+))" % name, attrs, re.I)
+    if not m:
+        return ""
+    return next(g for g in m.groups()[1:] if g is not None)
+
+
+def minify_css(css):
+    css = re.sub(r"/\*.*?\*/", "", css, flags=re.S)
+    css = re.sub(r"\s+", " ", css)
+    css = re.sub(r"\s*([{};,>])\s*", r"\1", css)
+    css = re.sub(r":\s+", ":", css)
+    css = css.replace(";}", "}")
+    return css.strip()
+
+
+def minify_html(html):
+    # whitespace inside these is content
+    parts = re.split(r"(<(pre|textarea|script)\b.*?</\2>)", html, flags=re.S | re.I)
+    out = []
+    for i, part in enumerate(parts):
+        if i % 3 == 2:
+            continue  # the tag name group
+        if i % 3 == 1:
+            out.append(part)
+            continue
+        part = re.sub(r"<!--(?!\[).*?-->", "", part, flags=re.S)
+        out.append(re.sub(r"\s+", " ", part))
+    return "".join(out).strip()
+
+
+REGEX_AFTER = set("(,=:[!&|?{};+-*%<>~^")
+REGEX_KEYWORDS = ("return", "typeof", "case", "do", "else", "in", "of", "void", "delete", "throw")
+NEWLINE_DROPPABLE_AFTER = set("{;,([=:?&|!<>*%")
+
+
+def minify_js(src):
+    """Drops comments and indentation. Line breaks stay unless the previous token cannot end a
+    statement, so automatic semicolon insertion keeps working; there is no renaming."""
+    out = []
+    i, n = 0, len(src)
+
+    def last():
+        return out[-1][-1] if out and out[-1] else ""
+
+    def significant():
+        for piece in reversed(out):
+            stripped = piece.rstrip()
+            if stripped:
+                return stripped
+        return ""
+
+    while i < n:
+        c = src[i]
+        if c in "\"'`":
+            j = i + 1
+            while j < n and src[j] != c:
+                j += 2 if src[j] == "\\" else 1
+            out.append(src[i:j + 1])
+            i = j + 1
+        elif src.startswith("//", i):
+            while i < n and src[i] != "\n":
+                i += 1
+        elif src.startswith("/*", i):
+            end = src.find("*/", i + 2)
+            i = n if end < 0 else end + 2
+            out.append(" ")
+        elif c == "/" and (not significant() or significant()[-1] in REGEX_AFTER
+                           or re.search(r"\b(%s)$" % "|".join(REGEX_KEYWORDS), significant())):
+            j, in_class = i + 1, False
+            while j < n and (src[j] != "/" or in_class) and src[j] != "\n":
+                if src[j] == "\\":
+                    j += 1
+                elif src[j] == "[":
+                    in_class = True
+                elif src[j] == "]":
+                    in_class = False
+                j += 1
+            j += 1
+            while j < n and (src[j].isalnum()):
+                j += 1
+            out.append(src[i:j])
+            i = j
+        elif c.isspace():
+            j = i
+            while j < n and src[j].isspace():
+                j += 1
+            run, nxt, prev = src[i:j], src[j:j + 1], last()
+            i = j
+            if not prev or not nxt:
+                continue
+            if "\n" in run and prev not in NEWLINE_DROPPABLE_AFTER and nxt not in "}),;.":
+                out.append("\n")
+            elif (is_word(prev) and is_word(nxt)) or (prev in "+-" and nxt in "+-"):
+                out.append(" ")
+        else:
+            out.append(c)
+            i += 1
+    return "".join(out).strip()
+
+
+def is_word(c):
+    return c.isalnum() or c in "_$\\" or ord(c) > 127
+
+
+embed = env.GetProjectOption("custom_web_embed", "no").lower() in ("yes", "true", "1")  # noqa: F821
+filesystem = any(t in FS_TARGETS for t in COMMAND_LINE_TARGETS)  # noqa: F821
+if embed or filesystem:
+    source = env.subst("$PROJECT_DATA_DIR")  # noqa: F821
+    output = os.path.join(env.subst("$BUILD_DIR"), "data")  # noqa: F821
+    cache = os.path.join(env.subst("$PROJECT_WORKSPACE_DIR"), "web-cache")  # noqa: F821
+    Pipeline(source, output, cache).run()
+    if embed:
+        generated = os.path.join(env.subst("$BUILD_DIR"), "web")  # noqa: F821
+        write_embedded(output, os.path.join(generated, EMBED_HEADER))
+        env.Append(CPPPATH=[generated], CPPDEFINES=["WEB_ASSETS_EMBEDDED"])  # noqa: F821
+    if filesystem:
+        env.Replace(PROJECT_DATA_DIR=output)  # noqa: F821
@@ -10,6 +10,9 @@
 #include "SPIFFS.h"
 #include "LittleFS.h"
 #include <Arduino_JSON.h>
+#ifdef WEB_ASSETS_EMBEDDED
+#include "web_assets.h"
+#endif
 
 const char* ssid = "The_internet"; /**< WiFi SSID */
 const char* password = "Hm4p5m59"; /**< WiFi password */
@@ -19,6 +22,18 @@ OneWire oneWire(oneWireBus); /**< OneWire object for temperature sensor */
 
 String latestItmes; /**< String to store the latest temperature readings */
 
+AsyncWebSharedBody historicalData; /**< latestItmes as shared by all /historical_data responses */
+
+/** /historical_data as sent, compressed once per published version for all dashboards */
+AsyncWebResponseCache historicalResponses("text/plain",
+  [](){ return historicalData.version(); },
+  [](AsyncWebServerRequest *request){
+    AsyncWebSharedBuffer* data = historicalData.acquire();
+    return data ? data : AsyncWebSharedBuffer::create(""); // empty until the first sync
+  });
+
+float latestTemperature = NAN; /**< Last temperature read by loop(), shown on the index page */
+
 DallasTemperature sensors(&oneWire); /**< Dallas Temperature sensor object */
 
 AsyncWebServer server(80); /**< AsyncWebServer instance */
@@ -47,6 +62,25 @@ String read_temp(const String& var) {
   }
 }
 
+/**
+ * @brief Template processor for the index page.
+ * @param var The placeholder name found in the page.
+ * @return The value shown in place of the placeholder.
+ */
+String processor(const String& var) {
+  if(var == "TEMPERATURE")
+  {
+    return String(latestTemperature);
+  }
+  return String();
+}
+
+#ifdef WEB_ASSETS_EMBEDDED
+AsyncWebRenderCache indexPage(webAssets.find("/index.html")->data, webAssets.find("/index.html")->length, processor); /**< index.html rendered with the latest reading */
+#else
+AsyncWebRenderCache indexPage("/index.html", processor); /**< index.html rendered with the latest reading */
+#endif
+
 /**
  * @brief Notify all WebSocket clients with sensor readings.
  * @param sensorReadings The sensor readings to send to clients.
@@ -131,8 +165,9 @@ void logTemperature(float temperature) {
  * @brief Synchronizes historical temperature data for serving to clients.
  *
  * This function reads historical temperature data from the SD card and synchronizes
- * it with the 'latestItmes' variable. It ensures that the number of historical
- * readings does not exceed the maximum limit defined by 'maxItems'.
+ * it with the 'latestItmes' variable and the 'historicalData' body served over HTTP.
+ * It ensures that the number of historical readings does not exceed the maximum
+ * limit defined by 'maxItems'.
  */
 void syncHistoricalData() {
   String data = "";
@@ -171,6 +206,7 @@ void syncHistoricalData() {
   }
 
   latestItmes = data;
+  historicalData.publish(data.c_str());
 }
 
 /**
@@ -221,23 +257,35 @@ void setup(){
   } 
 
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send(SPIFFS, "/index.html", "text/html", false);
+#ifdef WEB_ASSETS_EMBEDDED
+    indexPage.send(request, "text/html");
+#else
+    indexPage.send(request, SPIFFS, "text/html");
+#endif
   });
 
   server.on("/temperature", HTTP_GET, [](AsyncWebServerRequest *request){
     request->send_P(200, "text/plain", read_temp("TEMPC").c_str());
   });
 
+  historicalResponses.setGzip(true); // the readings are repetitive text, they shrink to a fraction
   server.on("/historical_data", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send(200, "text/plain", latestItmes);
+    historicalResponses.send(request);
   });
 
-   server.serveStatic("/", SPIFFS, "/");
+#ifdef WEB_ASSETS_EMBEDDED
+   server.serveEmbedded("/", webAssets);
+#else
+   // scripts/build_web.py writes the hashed bundles and the manifest naming them
+   server.serveStatic("/", SPIFFS, "/").setRamCache(16384).setImmutable("/assets.manifest");
+#endif
   server.begin();
 }
  
 void loop(){
   float temperature = read_temp("TEMPC").toFloat();
+  latestTemperature = temperature;
+  indexPage.invalidate();
   logTemperature(temperature);
   syncHistoricalData();
 